@@ -0,0 +1,436 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <X11/Intrinsic.h>
+#include <X11/Xutil.h>
+
+#include "apply.h"
+#include "palette.h"
+#include "root.h"
+#include "xbm.h"
+#include "archive.h"
+#include "stats.h"
+
+
+/* Upper bound, the memory cap usually allows far fewer full screens. */
+#define MAX_CACHED 32
+
+
+/* A rendered root pixmap, key: file, fg, bg. */
+struct cached {
+  char const *filename;
+  uint32_t fg,
+           bg;
+  Pixmap pixmap;
+  size_t bytes;
+  unsigned long lastUse;
+};
+
+struct decoded {
+  char const *filename;
+  XbmBuffer buffer;
+  unsigned int width,
+               height;
+  int status;
+};
+
+
+static XtAppContext app = NULL;
+
+static Display *display = NULL;
+
+static void (*appliedProc)(char const *, uint32_t, uint32_t) = NULL;
+
+/* Two slots: 'current' belongs to the Xt thread, 'spare' to the decoder
+ * until it is ready. They are swapped when a decoded file is taken.
+ * */
+static struct decoded slots[2];
+
+static struct decoded *current = &slots[0],
+                      *spare = &slots[1];
+
+/* Shared with the decoder thread, under 'mutex'. */
+static char const *wantFile = NULL,
+                  *busyFile = NULL;
+
+static Boolean ready = False;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static int pipeFds[2] = {-1, -1};
+
+/* Xt thread only. */
+static char const *latestFile = NULL,
+                  *shownFile = NULL;
+
+static uint32_t latestFg = 0,
+                latestBg = 0,
+                shownFg = 0,
+                shownBg = 0;
+
+static Boolean renderPending = False;
+
+static Pixmap shownPixmap = None;
+
+static struct cached cache[MAX_CACHED];
+
+static size_t ncached = 0,
+              cacheBytes = 0,
+              cacheLimit = 0;
+
+static unsigned long useCounter = 0;
+
+/* Server memory of one root pixmap. */
+static size_t rootBytes = 0;
+
+/* The part of a bitmap that can be seen, read by the decoder. */
+static unsigned int screenWidth = 0,
+                    screenHeight = 0;
+
+/* When the wallpaper on the way was requested, for --stats. */
+static double requestTime = 0;
+
+
+static int same_file(char const *a, char const *b)
+{
+  return a && b && (a == b || strcmp(a, b) == 0);
+}
+
+
+/* Server memory of a full screen pixmap. */
+static size_t screen_bytes(Screen *screen)
+{
+  int const depth = DefaultDepthOfScreen(screen);
+  int bpp = depth,
+      n = 0;
+  XPixmapFormatValues *const formats = XListPixmapFormats(display, &n);
+
+  for (int i = 0; i < n; ++i) {
+    if (formats[i].depth == depth) {
+      bpp = formats[i].bits_per_pixel;
+      break;
+    }
+  }
+
+  if (formats) {
+    XFree(formats);
+  }
+
+  return (size_t)WidthOfScreen(screen) * HeightOfScreen(screen) * bpp / 8;
+}
+
+
+static struct cached *cache_find(char const *filename, uint32_t fg, uint32_t bg)
+{
+  for (size_t i = 0; i < ncached; ++i) {
+    struct cached *const c = &cache[i];
+
+    if (c->fg == fg && c->bg == bg && same_file(c->filename, filename)) {
+      return c;
+    }
+  }
+  return NULL;
+}
+
+
+static Boolean is_cached(Pixmap pixmap)
+{
+  for (size_t i = 0; i < ncached; ++i) {
+    if (cache[i].pixmap == pixmap) {
+      return True;
+    }
+  }
+  return False;
+}
+
+
+/* Drops the least recently used entries until 'bytes' more fit,
+ * the pixmap on screen is never freed.
+ * */
+static void cache_evict(size_t bytes)
+{
+  while (ncached > 0 && (cacheBytes + bytes > cacheLimit || ncached == MAX_CACHED)) {
+    size_t lru = 0;
+
+    for (size_t i = 1; i < ncached; ++i) {
+      if (cache[i].lastUse < cache[lru].lastUse) {
+        lru = i;
+      }
+    }
+
+    if (cache[lru].pixmap != shownPixmap) {
+      XFreePixmap(display, cache[lru].pixmap);
+      StatsPixmap(-(long)rootBytes);
+    }
+
+    cacheBytes -= cache[lru].bytes;
+    cache[lru] = cache[--ncached];
+  }
+}
+
+
+static void cache_insert(char const *filename, uint32_t fg, uint32_t bg,
+                         Pixmap pixmap, size_t bytes)
+{
+  if (bytes > cacheLimit) {
+    return;
+  }
+
+  cache_evict(bytes);
+
+  cache[ncached++] = (struct cached){
+    .filename = filename, .fg = fg, .bg = bg,
+    .pixmap = pixmap, .bytes = bytes, .lastUse = ++useCounter,
+  };
+
+  cacheBytes += bytes;
+}
+
+
+/* Puts 'pixmap' on screen, the previous one is freed unless cached. */
+static void show(Pixmap pixmap)
+{
+  Pixmap const old = shownPixmap;
+
+  RootApply(display, DefaultScreenOfDisplay(display), pixmap);
+  shownPixmap = pixmap;
+
+  if (old != None && old != pixmap && !is_cached(old)) {
+    XFreePixmap(display, old);
+    StatsPixmap(-(long)rootBytes);
+  }
+}
+
+
+static void *Decoder(void *arg)
+{
+  (void)arg; /*UNUSED*/
+
+  int hotX, hotY;
+
+  pthread_mutex_lock(&mutex);
+
+  for (;;) {
+    while (!wantFile || ready) {
+      pthread_cond_wait(&cond, &mutex);
+    }
+
+    struct decoded *const d = spare;
+
+    d->filename = busyFile = wantFile;
+    wantFile = NULL;
+    pthread_mutex_unlock(&mutex);
+
+    d->status = ArchiveMapClip(d->filename, &d->buffer,
+                               screenWidth, screenHeight,
+                               &d->width, &d->height, &hotX, &hotY);
+
+    pthread_mutex_lock(&mutex);
+    ready = True;
+
+    /* A full pipe already has a wake-up in it. */
+    while (write(pipeFds[1], "", 1) == -1 && errno == EINTR);
+  }
+
+  return NULL;
+}
+
+
+/* Work procedure: runs once the pending events are handled, so a burst
+ * of requests ends in a single render of the latest one.
+ * */
+static Boolean Render(XtPointer clientData)
+{
+  (void)clientData; /*UNUSED*/
+
+  renderPending = False;
+
+  if (same_file(shownFile, latestFile) &&
+      shownFg == latestFg && shownBg == latestBg) {
+    return True;
+  }
+
+  struct cached *const hit = cache_find(latestFile, latestFg, latestBg);
+
+  if (hit) {
+    /* No I/O and no rendering. */
+    hit->lastUse = ++useCounter;
+    show(hit->pixmap);
+    StatsApply(latestFile, requestTime, True);
+  } else if (current->status == BitmapSuccess &&
+             same_file(current->filename, latestFile)) {
+    Screen *const screen = DefaultScreenOfDisplay(display);
+
+    Pixmap const pixmap = RootRender(display, screen, current->buffer.data,
+                                     current->width, current->height,
+                                     PaletteRGBToPixel(latestFg),
+                                     PaletteRGBToPixel(latestBg));
+
+    StatsPixmap((long)rootBytes);
+    show(pixmap);
+    cache_insert(latestFile, latestFg, latestBg, pixmap, rootBytes);
+    StatsApply(latestFile, requestTime, False);
+  } else {
+    /* Still decoding. */
+    return True;
+  }
+
+  shownFile = latestFile;
+  shownFg = latestFg;
+  shownBg = latestBg;
+
+  if (appliedProc) {
+    appliedProc(shownFile, shownFg, shownBg);
+  }
+  return True;
+}
+
+
+static void schedule_render(void)
+{
+  if (!renderPending) {
+    renderPending = True;
+    XtAppAddWorkProc(app, Render, NULL);
+  }
+}
+
+
+static void Decoded(XtPointer clientData, int *fd, XtInputId *id)
+{
+  (void)clientData; /*UNUSED*/
+  (void)id;         /*UNUSED*/
+
+  char drain[64];
+
+  while (read(*fd, drain, sizeof(drain)) > 0);
+
+  pthread_mutex_lock(&mutex);
+
+  if (ready) {
+    struct decoded *const d = spare;
+
+    ready = False;
+    busyFile = NULL;
+
+    if (same_file(d->filename, latestFile)) {
+      if (d->status == BitmapSuccess) {
+        spare = current;
+        current = d;
+        schedule_render();
+      } else {
+        fprintf(stderr, "Error reading the bitmap file: %s\n", d->filename);
+      }
+    }
+    /* else: superseded, the decoder goes on with 'wantFile'. */
+
+    pthread_cond_signal(&cond);
+  }
+
+  pthread_mutex_unlock(&mutex);
+}
+
+
+void ApplyInit(XtAppContext appContext, Display *dpy, size_t cacheSize,
+               void (*applied)(char const *, uint32_t, uint32_t))
+{
+  app = appContext;
+  cacheLimit = cacheSize;
+  display = dpy;
+  appliedProc = applied;
+  rootBytes = screen_bytes(DefaultScreenOfDisplay(display));
+  screenWidth = (unsigned int)WidthOfScreen(DefaultScreenOfDisplay(display));
+  screenHeight = (unsigned int)HeightOfScreen(DefaultScreenOfDisplay(display));
+
+  for (size_t i = 0; i < 2; ++i) {
+    slots[i].status = BitmapFileInvalid;
+  }
+
+  if (pipe(pipeFds) == -1) {
+    perror("ApplyInit: pipe");
+    exit(EXIT_FAILURE);
+  }
+
+  fcntl(pipeFds[0], F_SETFL, O_NONBLOCK);
+  fcntl(pipeFds[1], F_SETFL, O_NONBLOCK);
+
+  XtAppAddInput(app, pipeFds[0], (XtPointer)XtInputReadMask, Decoded, NULL);
+
+  pthread_t thread;
+
+  if (pthread_create(&thread, NULL, Decoder, NULL) != 0) {
+    perror("ApplyInit: pthread_create");
+    exit(EXIT_FAILURE);
+  }
+
+  pthread_detach(thread);
+}
+
+
+void ApplyRequest(char const *filename, uint32_t fg, uint32_t bg)
+{
+  latestFile = filename;
+  latestFg = fg;
+  latestBg = bg;
+  requestTime = StatsNow();
+
+  pthread_mutex_lock(&mutex);
+
+  /* Already rendered, or only the colors changed: nothing to read. */
+  if (cache_find(filename, fg, bg) ||
+      (current->status == BitmapSuccess &&
+       same_file(current->filename, filename))) {
+    wantFile = NULL;
+    pthread_mutex_unlock(&mutex);
+    schedule_render();
+    return;
+  }
+
+  if (same_file(busyFile, filename)) {
+    wantFile = NULL;
+  } else {
+    wantFile = filename;
+    pthread_cond_signal(&cond);
+  }
+
+  pthread_mutex_unlock(&mutex);
+}
+
+
+char const *ApplyShown(uint32_t *fg, uint32_t *bg)
+{
+  if (shownFile) {
+    *fg = shownFg;
+    *bg = shownBg;
+  }
+  return shownFile;
+}
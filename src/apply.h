@@ -0,0 +1,48 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <X11/Intrinsic.h>
+
+/* Asynchronous wallpaper pipeline.
+ *
+ * The file is parsed in a background thread, its completion arrives
+ * through XtAppAddInput and the rendering runs in a work procedure, so
+ * the Xt loop never waits. Only the latest request matters: a request
+ * that is superseded while in flight is dropped.
+ * */
+
+/* 'applied' is called on the Xt thread each time a wallpaper is set.
+ * Up to 'cacheSize' bytes of rendered root pixmaps are kept, so going
+ * back to a recent bitmap/fg/bg is a single XSetWindowBackgroundPixmap.
+ * */
+void ApplyInit(XtAppContext appContext, Display *display, size_t cacheSize,
+               void (*applied)(char const *filename, uint32_t fg, uint32_t bg));
+
+/* Requests 'filename' with colors 'fg' and 'bg' (0xRRGGBB).
+ * 'filename' must stay valid while the application runs.
+ * */
+void ApplyRequest(char const *filename, uint32_t fg, uint32_t bg);
+
+/* File and colors of the wallpaper on screen, NULL if none is set. */
+char const *ApplyShown(uint32_t *fg, uint32_t *bg);
@@ -0,0 +1,512 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+/* Layout of a .xbp file, in the byte order of the machine that wrote it:
+ *
+ *   header
+ *   index    'count' entries sorted by name
+ *   names    NUL terminated
+ *   bits     XBM bit planes (LSB first, rows padded to a byte); planes
+ *            of a page or more start on a page boundary, smaller ones
+ *            on ALIGN bytes
+ * */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "archive.h"
+#include "thumb.h"
+
+#define MAGIC "XBP1"
+#define BYTE_ORDER_MARK 0x01020304u
+#define VERSION_FORMAT 1
+#define ALIGN 16
+
+#define MAX_ARCHIVES 64
+
+/* Bytes of a file decoded at once by ArchiveMapClip. */
+#define CLIP_STRIP (64 << 10)
+
+
+struct header {
+  char magic[4];
+  uint32_t byteOrder,
+           version,
+           count;
+  uint64_t namesOffset,
+           namesSize;
+};
+
+struct entry {
+  uint64_t offset;
+  uint32_t name,
+           width,
+           height;
+  int32_t hotX,
+          hotY;
+  uint32_t reserved;
+};
+
+struct archive {
+  char *path;
+  size_t pathLen;
+  unsigned char const *map;
+  size_t size;
+  struct entry const *entries;
+  char const *names;
+  uint32_t count;
+};
+
+
+static struct archive archives[MAX_ARCHIVES];
+
+static size_t narchives = 0;
+
+/* The loader looks up entries while the scan opens more archives. */
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static size_t align_up(size_t value, size_t align)
+{
+  return (value + align - 1) / align * align;
+}
+
+
+/* Bytes of a bit plane, it can not overflow in 64 bits. */
+static uint64_t plane_size(uint32_t width, uint32_t height)
+{
+  return ((uint64_t)width + 7) / 8 * height;
+}
+
+
+/* Length of the directory all 'files' share, with its final '/'. */
+static size_t common_dir(char *const files[], size_t count)
+{
+  size_t len = strlen(files[0]);
+
+  for (size_t i = 1; i < count; ++i) {
+    size_t k = 0;
+
+    while (k < len && files[i][k] == files[0][k]) {
+      ++k;
+    }
+    len = k;
+  }
+
+  while (len > 0 && files[0][len - 1] != '/') {
+    --len;
+  }
+  return len;
+}
+
+
+struct packed {
+  char const *name;
+  unsigned char *data;
+  unsigned int width,
+               height;
+  int hotX,
+      hotY;
+};
+
+
+static int compare_packed(void const *a, void const *b)
+{
+  return strcmp(((struct packed const *)a)->name,
+                ((struct packed const *)b)->name);
+}
+
+
+static int write_zeros(FILE *file, size_t count)
+{
+  static char const zeros[ALIGN * 16];
+
+  while (count > 0) {
+    size_t const n = count < sizeof(zeros) ? count : sizeof(zeros);
+
+    if (fwrite(zeros, 1, n, file) != n) {
+      return 0;
+    }
+    count -= n;
+  }
+  return 1;
+}
+
+
+int ArchivePack(char *const files[], size_t count, char const *output)
+{
+  if (count == 0) {
+    fprintf(stderr, "No bitmaps to pack\n");
+    return 0;
+  }
+
+  struct packed *const packed = calloc(count, sizeof(*packed));
+
+  assert(packed != NULL);
+
+  size_t const prefix = common_dir(files, count);
+  size_t npacked = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    struct packed *const p = &packed[npacked];
+
+    if (XbmReadFile(files[i], &p->width, &p->height, &p->data,
+                    &p->hotX, &p->hotY) != BitmapSuccess) {
+      fprintf(stderr, "Error reading the bitmap file: %s\n", files[i]);
+      continue;
+    }
+
+    p->name = files[i] + prefix;
+    ++npacked;
+  }
+
+  qsort(packed, npacked, sizeof(*packed), compare_packed);
+
+  /* Layout */
+  size_t const page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t namesSize = 0;
+
+  for (size_t i = 0; i < npacked; ++i) {
+    namesSize += strlen(packed[i].name) + 1;
+  }
+
+  size_t const namesOffset = sizeof(struct header) +
+                             npacked * sizeof(struct entry);
+
+  struct entry *const entries = calloc(npacked ? npacked : 1, sizeof(*entries));
+
+  assert(entries != NULL);
+
+  size_t offset = align_up(namesOffset + namesSize, page),
+         name = 0;
+
+  for (size_t i = 0; i < npacked; ++i) {
+    struct packed const *const p = &packed[i];
+    size_t const size = plane_size(p->width, p->height);
+
+    offset = align_up(offset, size >= page ? page : ALIGN);
+
+    entries[i] = (struct entry){
+      .offset = offset, .name = (uint32_t)name,
+      .width = p->width, .height = p->height,
+      .hotX = p->hotX, .hotY = p->hotY,
+    };
+
+    offset += size;
+    name += strlen(p->name) + 1;
+  }
+
+  struct header header = {
+    .byteOrder = BYTE_ORDER_MARK, .version = VERSION_FORMAT,
+    .count = (uint32_t)npacked, .namesOffset = namesOffset,
+    .namesSize = namesSize,
+  };
+
+  memcpy(header.magic, MAGIC, sizeof(header.magic));
+
+  /* Write */
+  FILE *const file = fopen(output, "wb");
+  int ok = (file != NULL);
+
+  ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+  ok = ok && (npacked == 0 ||
+              fwrite(entries, sizeof(*entries), npacked, file) == npacked);
+
+  for (size_t i = 0; ok && i < npacked; ++i) {
+    ok = fwrite(packed[i].name, strlen(packed[i].name) + 1, 1, file) == 1;
+  }
+
+  size_t position = namesOffset + namesSize;
+
+  for (size_t i = 0; ok && i < npacked; ++i) {
+    size_t const size = plane_size(packed[i].width, packed[i].height);
+
+    ok = write_zeros(file, entries[i].offset - position) &&
+         fwrite(packed[i].data, 1, size, file) == size;
+    position = entries[i].offset + size;
+  }
+
+  if (file && fclose(file) != 0) {
+    ok = 0;
+  }
+
+  if (!ok) {
+    perror(output);
+    unlink(output);
+  } else {
+    printf("%zu bitmaps packed in %s\n", npacked, output);
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    free(packed[i].data);
+  }
+
+  free(entries);
+  free(packed);
+  return ok;
+}
+
+
+/* Checks everything the readers rely on. */
+static int validate(struct archive const *a)
+{
+  struct header const *const h = (struct header const *)a->map;
+
+  if (a->size < sizeof(*h) || memcmp(h->magic, MAGIC, 4) != 0 ||
+      h->byteOrder != BYTE_ORDER_MARK || h->version != VERSION_FORMAT) {
+    return 0;
+  }
+
+  if (h->namesOffset != sizeof(*h) + (uint64_t)h->count * sizeof(struct entry) ||
+      h->namesOffset > a->size || h->namesSize > a->size - h->namesOffset ||
+      (h->count > 0 && (h->namesSize == 0 ||
+                        a->names[h->namesSize - 1] != '\0'))) {
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < h->count; ++i) {
+    struct entry const *const e = &a->entries[i];
+
+    /* The readers compute XBM_STRIDE in unsigned int. */
+    if (e->name >= h->namesSize || e->offset > a->size ||
+        e->width == 0 || e->height == 0 || e->width > UINT32_MAX - 7 ||
+        plane_size(e->width, e->height) > a->size - e->offset) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+char **ArchiveOpen(char const *filename, size_t *count)
+{
+  if (narchives == MAX_ARCHIVES) {
+    fprintf(stderr, "Too many archives: %s\n", filename);
+    return NULL;
+  }
+
+  int const fd = open(filename, O_RDONLY);
+  struct stat st;
+
+  if (fd == -1 || fstat(fd, &st) == -1 || st.st_size == 0) {
+    if (fd != -1) {
+      close(fd);
+    }
+    fprintf(stderr, "Error opening the archive: %s\n", filename);
+    return NULL;
+  }
+
+  struct archive *const a = &archives[narchives];
+
+  a->size = (size_t)st.st_size;
+  a->map = mmap(NULL, a->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (a->map == MAP_FAILED) {
+    fprintf(stderr, "Error opening the archive: %s\n", filename);
+    return NULL;
+  }
+
+  /* The loader walks it from start to end. */
+  posix_madvise((void *)a->map, a->size, POSIX_MADV_WILLNEED);
+
+  struct header const *const h = (struct header const *)a->map;
+
+  a->entries = (struct entry const *)(a->map + sizeof(*h));
+  a->names = (char const *)a->map + (a->size >= sizeof(*h) ? h->namesOffset : 0);
+
+  if (!validate(a)) {
+    fprintf(stderr, "Invalid archive: %s\n", filename);
+    munmap((void *)a->map, a->size);
+    return NULL;
+  }
+
+  a->count = h->count;
+  a->path = strdup(filename);
+  a->pathLen = strlen(filename);
+
+  char **const names = malloc((a->count ? a->count : 1) * sizeof(*names));
+
+  assert(a->path != NULL && names != NULL);
+
+  for (uint32_t i = 0; i < a->count; ++i) {
+    char const *const name = a->names + a->entries[i].name;
+
+    names[i] = malloc(a->pathLen + strlen(name) + 2);
+    assert(names[i] != NULL);
+    sprintf(names[i], "%s:%s", filename, name);
+  }
+
+  pthread_mutex_lock(&mutex);
+  ++narchives;
+  pthread_mutex_unlock(&mutex);
+
+  *count = a->count;
+  return names;
+}
+
+
+unsigned char const *ArchiveFind(char const *name,
+                                 unsigned int *width, unsigned int *height,
+                                 int *hotX, int *hotY)
+{
+  pthread_mutex_lock(&mutex);
+
+  size_t const n = narchives;
+
+  pthread_mutex_unlock(&mutex);
+
+  for (size_t i = 0; i < n; ++i) {
+    struct archive const *const a = &archives[i];
+
+    if (strncmp(name, a->path, a->pathLen) != 0 || name[a->pathLen] != ':') {
+      continue;
+    }
+
+    char const *const key = name + a->pathLen + 1;
+    size_t low = 0,
+           high = a->count;
+
+    while (low < high) {
+      size_t const mid = low + (high - low) / 2;
+      struct entry const *const e = &a->entries[mid];
+      int const cmp = strcmp(key, a->names + e->name);
+
+      if (cmp == 0) {
+        *width = e->width;
+        *height = e->height;
+        *hotX = e->hotX;
+        *hotY = e->hotY;
+        return a->map + e->offset;
+      }
+
+      if (cmp < 0) {
+        high = mid;
+      } else {
+        low = mid + 1;
+      }
+    }
+  }
+  return NULL;
+}
+
+
+int ArchiveMapFile(char const *filename, XbmBuffer *buffer,
+                   unsigned int *width, unsigned int *height,
+                   int *hotX, int *hotY)
+{
+  unsigned char const *const bits = ArchiveFind(filename, width, height,
+                                                hotX, hotY);
+
+  if (NULL == bits) {
+    return XbmMapFile(filename, buffer, width, height, hotX, hotY);
+  }
+
+  size_t const size = plane_size(*width, *height);
+
+  if (!XbmBufferReserve(buffer, size)) {
+    return BitmapNoMemory;
+  }
+
+  memcpy(buffer->data, bits, size);
+  return BitmapSuccess;
+}
+
+
+struct clip {
+  XbmBuffer *buffer;
+  unsigned int width,
+               height;
+  int noMemory;
+};
+
+
+/* Copies the rows and columns of the strip that are kept. */
+static int Clip(void *closure, unsigned char const *bits,
+                unsigned int width, unsigned int height,
+                unsigned int y, unsigned int rows)
+{
+  struct clip *const c = closure;
+  size_t const stride = XBM_STRIDE(width);
+
+  if (y == 0) {
+    c->width = width < c->width ? width : c->width;
+    c->height = height < c->height ? height : c->height;
+
+    if (!XbmBufferReserve(c->buffer, XBM_STRIDE(c->width) * c->height)) {
+      c->noMemory = 1;
+      return 0;
+    }
+  }
+
+  size_t const clipStride = XBM_STRIDE(c->width);
+
+  for (unsigned int i = 0; i < rows && y + i < c->height; ++i) {
+    memcpy(c->buffer->data + (y + i) * clipStride, bits + i * stride, clipStride);
+  }
+
+  return y + rows < c->height;
+}
+
+
+int ArchiveMapClip(char const *filename, XbmBuffer *buffer,
+                   unsigned int maxWidth, unsigned int maxHeight,
+                   unsigned int *width, unsigned int *height,
+                   int *hotX, int *hotY)
+{
+  unsigned char const *const bits = ArchiveFind(filename, width, height,
+                                                hotX, hotY);
+  struct clip c = { buffer, maxWidth, maxHeight, 0 };
+
+  if (bits) {
+    Clip(&c, bits, *width, *height, 0, *height);
+  } else {
+    XbmBuffer strip = {0};
+    int const ret = XbmStreamFile(filename, &strip, CLIP_STRIP, Clip, &c,
+                                  width, height, hotX, hotY);
+
+    XbmBufferFree(&strip);
+
+    if (ret != BitmapSuccess) {
+      return ret;
+    }
+  }
+
+  if (c.noMemory) {
+    return BitmapNoMemory;
+  }
+
+  *width = c.width;
+  *height = c.height;
+  return BitmapSuccess;
+}
@@ -0,0 +1,67 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+
+#include "xbm.h"
+
+/* Collection archives: many bitmaps, already decoded, in one file that
+ * is mapped at startup. The entries are named "<archive>:<name>".
+ * */
+
+#define ARCHIVE_SUFFIX ".xbp"
+
+/* Writes the bitmaps 'files[0..count-1]' to 'output', the names are
+ * the paths relative to their common directory.
+ * Returns 0 on error, already reported on stderr.
+ * */
+int ArchivePack(char *const files[], size_t count, char const *output);
+
+/* Maps 'filename' and returns the names of its entries, sorted.
+ * The archive stays mapped until the end of the program.
+ * Returns NULL on error.
+ * */
+char **ArchiveOpen(char const *filename, size_t *count);
+
+/* The bits of the entry 'name' inside the mapping, NULL if 'name' is
+ * not an entry of an open archive. Safe from any thread, also while
+ * ArchiveOpen adds an archive.
+ * */
+unsigned char const *ArchiveFind(char const *name,
+                                 unsigned int *width, unsigned int *height,
+                                 int *hotX, int *hotY);
+
+/* XbmMapFile for both files and archive entries. */
+int ArchiveMapFile(char const *filename, XbmBuffer *buffer,
+                   unsigned int *width, unsigned int *height,
+                   int *hotX, int *hotY);
+
+/* Same as ArchiveMapFile, but only the top left 'maxWidth' x 'maxHeight'
+ * pixels are kept, and 'width' and 'height' are those of the part kept.
+ * Files are read in strips and only the rows kept are decoded, so a
+ * bitmap many times the size of the screen costs no more than the
+ * screen.
+ * */
+int ArchiveMapClip(char const *filename, XbmBuffer *buffer,
+                   unsigned int maxWidth, unsigned int maxHeight,
+                   unsigned int *width, unsigned int *height,
+                   int *hotX, int *hotY);
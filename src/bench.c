@@ -0,0 +1,716 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Microbenchmarks for xbmpwall.
+ *
+ * Usage: xbmpwall-bench [-n count] [-s min-max] [-r rounds] [directory]
+ *
+ * Without a directory a synthetic corpus of 'count' random bitmaps, with
+ * sides between 'min' and 'max' pixels, is written to a temporary
+ * directory and removed at the end.
+ *
+ * The phases of the load path are timed separately: parsing (libX11 and
+ * the built-in reader, which must agree on every file), thumbnails,
+ * pixmap upload, widget and grid creation and the palette. The X phases
+ * need $DISPLAY, "make bench" runs them under xvfb-run when it is unset.
+ *
+ * The color swatches are also created for 1250 to 10000 items, managed
+ * one at a time and in chunks, to show how the cost grows.
+ *
+ * Output: one tab-separated line per measurement, lines starting with
+ * '#' are comments.
+ * */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Intrinsic.h>
+#include <X11/StringDefs.h>
+#include <X11/Shell.h>
+#include <X11/Xaw/Box.h>
+#include <X11/Xaw/Command.h>
+#include <X11/Xaw/Form.h>
+
+#include "xbm.h"
+#include "thumb.h"
+#include "grid.h"
+#include "shm.h"
+#include "palette.h"
+#include "layout.h"
+
+#define DEFAULT_COUNT 1000
+#define DEFAULT_MIN_SIZE 8
+#define DEFAULT_MAX_SIZE 256
+#define DEFAULT_ROUNDS 5
+
+/* Largest number of swatches of the widget sweep. */
+#define SWEEP_MAX 10000
+
+
+static char **files = NULL;
+
+static size_t nfiles = 0,
+              capFiles = 0;
+
+/* Parsed once, input of the X phases. */
+struct parsed {
+  unsigned char *data,
+                *thumb;
+  unsigned int width,
+               height,
+               thumbWidth,
+               thumbHeight;
+};
+
+static struct parsed *parsed = NULL;
+
+static size_t nparsed = 0;
+
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void report(char const *phase, char const *name, size_t items,
+                   size_t bytes, double elapsed)
+{
+  printf("%s\t%s\t%zu\t%zu\t%.6f\t%.1f\n", phase, name, items, bytes,
+         elapsed, elapsed > 0 ? items / elapsed : 0.0);
+}
+
+
+static int has_xbm_suffix(char const *name)
+{
+  size_t const len = strlen(name);
+
+  return len > 4 && strcmp(name + len - 4, ".xbm") == 0;
+}
+
+
+static void add_file(char const *path)
+{
+  if (nfiles == capFiles) {
+    capFiles = capFiles ? capFiles * 2 : 256;
+    files = realloc(files, capFiles * sizeof(*files));
+
+    if (!files) {
+      perror("bench");
+      exit(EXIT_FAILURE);
+    }
+  }
+  files[nfiles++] = strdup(path);
+}
+
+
+static void collect(char const *dir)
+{
+  DIR *const d = opendir(dir);
+
+  if (!d) {
+    perror(dir);
+    return;
+  }
+
+  struct dirent *e;
+
+  while ((e = readdir(d))) {
+    if (e->d_name[0] == '.') {
+      continue;
+    }
+
+    char path[4096];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+
+    if (stat(path, &st) == -1) {
+      continue;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+      collect(path);
+    } else if (S_ISREG(st.st_mode) && has_xbm_suffix(e->d_name)) {
+      add_file(path);
+    }
+  }
+
+  closedir(d);
+}
+
+
+/* Random bitmaps in X11 format, the same seed gives the same corpus. */
+static void generate(char const *dir, size_t count,
+                     unsigned int minSize, unsigned int maxSize)
+{
+  srand(1);
+
+  for (size_t i = 0; i < count; ++i) {
+    unsigned int const width = minSize + rand() % (maxSize - minSize + 1);
+    unsigned int const height = minSize + rand() % (maxSize - minSize + 1);
+    size_t const size = XBM_STRIDE(width) * height;
+    char path[4096];
+
+    snprintf(path, sizeof(path), "%s/%06zu.xbm", dir, i);
+
+    FILE *const file = fopen(path, "w");
+
+    if (!file) {
+      perror(path);
+      exit(EXIT_FAILURE);
+    }
+
+    fprintf(file, "#define b%zu_width %u\n#define b%zu_height %u\n"
+                  "static unsigned char b%zu_bits[] = {",
+            i, width, i, height, i);
+
+    for (size_t k = 0; k < size; ++k) {
+      fprintf(file, "%s0x%02x", (k % 12) ? ", " : (k ? ",\n   " : "\n   "),
+              rand() & 0xFF);
+    }
+
+    fprintf(file, "};\n");
+    fclose(file);
+    add_file(path);
+  }
+}
+
+
+typedef int (*ReadFunc)(char const *, unsigned int *, unsigned int *,
+                        unsigned char **, int *, int *);
+
+
+static int read_libx11(char const *filename,
+                       unsigned int *width, unsigned int *height,
+                       unsigned char **data, int *hotX, int *hotY)
+{
+  unsigned char *xdata = NULL;
+  int const ret = XReadBitmapFileData(filename, width, height,
+                                      &xdata, hotX, hotY);
+
+  if (ret == BitmapSuccess) {
+    size_t const size = (*width + 7) / 8 * *height;
+
+    *data = malloc(size);
+    memcpy(*data, xdata, size);
+    XFree(xdata);
+  }
+  return ret;
+}
+
+
+/* XbmMapFile into one reused buffer, as the loader does. */
+static XbmBuffer mapBuffer;
+
+static int read_mapped(char const *filename,
+                       unsigned int *width, unsigned int *height,
+                       unsigned char **data, int *hotX, int *hotY)
+{
+  int const ret = XbmMapFile(filename, &mapBuffer, width, height, hotX, hotY);
+
+  /* bench_parser() frees the result */
+  *data = NULL;
+  return ret;
+}
+
+
+static void bench_parser(char const *name, ReadFunc read, int rounds)
+{
+  size_t bytes = 0;
+  double const start = now();
+
+  for (int r = 0; r < rounds; ++r) {
+    for (size_t i = 0; i < nfiles; ++i) {
+      unsigned int width, height;
+      unsigned char *data = NULL;
+      int hotX, hotY;
+
+      if (read(files[i], &width, &height, &data, &hotX, &hotY) == BitmapSuccess) {
+        bytes += (width + 7) / 8 * height;
+        free(data);
+      }
+    }
+  }
+
+  report("parse", name, nfiles * rounds, bytes, now() - start);
+}
+
+
+/* Both readers must agree on every file. */
+static size_t compare_parsers(void)
+{
+  size_t mismatches = 0;
+
+  for (size_t i = 0; i < nfiles; ++i) {
+    unsigned int w1 = 0, h1 = 0, w2 = 0, h2 = 0;
+    unsigned char *d1 = NULL, *d2 = NULL;
+    int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+
+    int const r1 = read_libx11(files[i], &w1, &h1, &d1, &x1, &y1);
+    int const r2 = XbmReadFile(files[i], &w2, &h2, &d2, &x2, &y2);
+
+    if (r1 != r2 || (r1 == BitmapSuccess &&
+        (w1 != w2 || h1 != h2 || x1 != x2 || y1 != y2 ||
+         memcmp(d1, d2, (w1 + 7) / 8 * h1) != 0))) {
+      fprintf(stderr, "mismatch: %s\n", files[i]);
+      ++mismatches;
+    }
+
+    free(d1);
+    free(d2);
+  }
+  return mismatches;
+}
+
+
+/* Full bitmaps and their thumbnails, kept for the X phases. */
+static void bench_thumbnails(void)
+{
+  parsed = calloc(nfiles ? nfiles : 1, sizeof(*parsed));
+
+  if (!parsed) {
+    perror("bench");
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t i = 0; i < nfiles; ++i) {
+    struct parsed *const p = &parsed[i];
+    int hotX, hotY;
+
+    if (XbmReadFile(files[i], &p->width, &p->height, &p->data,
+                    &hotX, &hotY) == BitmapSuccess) {
+      ++nparsed;
+    }
+  }
+
+  size_t bytes = 0;
+  double const start = now();
+
+  for (size_t i = 0; i < nfiles; ++i) {
+    struct parsed *const p = &parsed[i];
+
+    if (!p->data) {
+      continue;
+    }
+
+    ThumbSize(p->width, p->height, ITEM_SIZE, &p->thumbWidth, &p->thumbHeight);
+    p->thumb = malloc(XBM_STRIDE(p->thumbWidth) * p->thumbHeight);
+
+    if (p->thumbWidth == p->width && p->thumbHeight == p->height) {
+      memcpy(p->thumb, p->data, XBM_STRIDE(p->width) * p->height);
+    } else {
+      ThumbScale(p->data, p->width, p->height,
+                 p->thumb, p->thumbWidth, p->thumbHeight);
+    }
+
+    bytes += XBM_STRIDE(p->thumbWidth) * p->thumbHeight;
+  }
+
+  report("thumbnail", "ThumbScale", nparsed, bytes, now() - start);
+}
+
+
+static Pixmap create_bitmap(Display *display, Drawable drawable,
+                            unsigned char const *bits,
+                            unsigned int width, unsigned int height)
+{
+  return XCreateBitmapFromData(display, drawable, (char *)bits, width, height);
+}
+
+
+/* Server side pixmaps, full size as xbmpwall 1.17 did and thumbnails. */
+static void bench_upload(Display *display)
+{
+  Window const root = DefaultRootWindow(display);
+  int const screen = DefaultScreen(display);
+  Pixmap *const pixmaps = calloc(nfiles ? nfiles : 1, sizeof(*pixmaps));
+  size_t bytes = 0;
+
+  XSync(display, False);
+
+  double start = now();
+
+  for (size_t i = 0; i < nfiles; ++i) {
+    struct parsed const *const p = &parsed[i];
+
+    if (p->data) {
+      pixmaps[i] = XCreatePixmapFromBitmapData(display, root,
+                    (char *)p->data, p->width, p->height,
+                    BlackPixel(display, screen), WhitePixel(display, screen),
+                    DefaultDepth(display, screen));
+      bytes += XBM_STRIDE(p->width) * p->height;
+    }
+  }
+
+  XSync(display, False);
+  report("upload", "XCreatePixmapFromBitmapData", nparsed, bytes, now() - start);
+
+  for (size_t i = 0; i < nfiles; ++i) {
+    if (pixmaps[i] != None) {
+      XFreePixmap(display, pixmaps[i]);
+      pixmaps[i] = None;
+    }
+  }
+
+  /* Bitmaps, through the socket and through MIT-SHM when available. */
+  static struct {
+    char const *name;
+    Pixmap (*create)(Display *, Drawable, unsigned char const *,
+                     unsigned int, unsigned int);
+  } const uploads[] = {
+    {"XCreateBitmapFromData", create_bitmap},
+    {"ShmCreateBitmap", ShmCreateBitmap},
+  };
+
+  for (size_t u = 0; u < sizeof(uploads) / sizeof(uploads[0]); ++u) {
+    for (int thumbs = 0; thumbs < 2; ++thumbs) {
+      char name[64];
+
+      snprintf(name, sizeof(name), "%s%s", uploads[u].name,
+               thumbs ? "-thumbnail" : "");
+
+      XSync(display, False);
+
+      bytes = 0;
+      start = now();
+
+      for (size_t i = 0; i < nfiles; ++i) {
+        struct parsed const *const p = &parsed[i];
+        unsigned char const *const bits = thumbs ? p->thumb : p->data;
+        unsigned int const width = thumbs ? p->thumbWidth : p->width,
+                           height = thumbs ? p->thumbHeight : p->height;
+
+        if (bits) {
+          pixmaps[i] = uploads[u].create(display, root, bits, width, height);
+          bytes += XBM_STRIDE(width) * height;
+        }
+      }
+
+      XSync(display, False);
+      report("upload", name, nparsed, bytes, now() - start);
+
+      for (size_t i = 0; i < nfiles; ++i) {
+        if (pixmaps[i] != None) {
+          XFreePixmap(display, pixmaps[i]);
+          pixmaps[i] = None;
+        }
+      }
+    }
+  }
+
+  free(pixmaps);
+}
+
+
+/* Processes everything the server has sent so far. */
+static void flush_events(XtAppContext app, Display *display)
+{
+  XSync(display, False);
+
+  while (XtAppPending(app)) {
+    XtAppProcessEvent(app, XtIMAll);
+  }
+}
+
+
+static void Select(Widget w, XtPointer clientData, XtPointer callData)
+{
+  (void)w;          /*UNUSED*/
+  (void)clientData; /*UNUSED*/
+  (void)callData;   /*UNUSED*/
+}
+
+
+/* A Command with a bitmap per file into a Box, as xbmpwall 1.17 did,
+ * and the virtualized grid that replaced it.
+ * */
+static void bench_widgets(XtAppContext app, Display *display)
+{
+  Widget const shell = XtVaAppCreateShell("xbmpwall-bench", "XBmpWallBench",
+        applicationShellWidgetClass, display,
+        XtNwidth, 640,
+        XtNheight, 600,
+        NULL);
+
+  Widget const box = XtVaCreateManagedWidget("box", boxWidgetClass, shell,
+        XtNwidth, 640,
+        NULL);
+
+  XtRealizeWidget(shell);
+  flush_events(app, display);
+
+  Window const root = DefaultRootWindow(display);
+  double start = now();
+
+  for (size_t i = 0; i < nfiles; ++i) {
+    struct parsed const *const p = &parsed[i];
+
+    if (!p->thumb) {
+      continue;
+    }
+
+    Pixmap const bitmap = XCreateBitmapFromData(display, root,
+                            (char *)p->thumb, p->thumbWidth, p->thumbHeight);
+
+    XtVaCreateManagedWidget(NULL, commandWidgetClass, box,
+          XtNbitmap, bitmap,
+          XtNwidth, ITEM_SIZE,
+          XtNheight, ITEM_SIZE,
+          NULL);
+  }
+
+  flush_events(app, display);
+  report("widget", "XtVaCreateManagedWidget-box", nparsed, 0, now() - start);
+
+  XtDestroyWidget(shell);
+  flush_events(app, display);
+
+  Widget const gridShell = XtVaAppCreateShell("xbmpwall-bench", "XBmpWallBench",
+        applicationShellWidgetClass, display,
+        XtNwidth, 640,
+        XtNheight, 600,
+        NULL);
+
+  Widget const form = XtVaCreateManagedWidget("form", formWidgetClass, gridShell,
+        NULL);
+
+  GridCreate(form, NULL, 610, 390, ITEM_SIZE, Select);
+  XtRealizeWidget(gridShell);
+  flush_events(app, display);
+
+  start = now();
+
+  for (size_t i = 0; i < nfiles; ++i) {
+    struct parsed const *const p = &parsed[i];
+
+    if (p->thumb) {
+      GridAppend(files[i], p->thumb, p->thumbWidth, p->thumbHeight,
+                 XbmHash(p->data, p->width, p->height));
+    }
+  }
+
+  flush_events(app, display);
+  report("widget", "GridAppend", nparsed, 0, now() - start);
+
+  XtDestroyWidget(gridShell);
+  flush_events(app, display);
+}
+
+
+/* 'count' color swatches in a Box, managed one by one or in chunks
+ * into a box that is managed last, as xbmpwall does.
+ * */
+static double swatches(XtAppContext app, Display *display, size_t count,
+                       int chunked)
+{
+  Widget const shell = XtVaAppCreateShell("xbmpwall-bench", "XBmpWallBench",
+        applicationShellWidgetClass, display,
+        XtNwidth, 640,
+        XtNheight, 600,
+        NULL);
+
+  Widget const box = chunked ?
+    XtVaCreateWidget("box", boxWidgetClass, shell, XtNwidth, 640, NULL) :
+    XtVaCreateManagedWidget("box", boxWidgetClass, shell, XtNwidth, 640, NULL);
+
+  XtRealizeWidget(shell);
+  flush_events(app, display);
+
+  Widget chunk[SWATCH_CHUNK];
+  Cardinal n = 0;
+  double const start = now();
+
+  for (size_t i = 0; i < count; ++i) {
+    if (!chunked) {
+      XtVaCreateManagedWidget(NULL, commandWidgetClass, box,
+            XtNwidth, ITEM_SIZE / 2,
+            XtNheight, ITEM_SIZE / 2,
+            NULL);
+      continue;
+    }
+
+    chunk[n++] = XtVaCreateWidget(NULL, commandWidgetClass, box,
+                   XtNwidth, ITEM_SIZE / 2,
+                   XtNheight, ITEM_SIZE / 2,
+                   NULL);
+
+    if (n == SWATCH_CHUNK || i + 1 == count) {
+      XtManageChildren(chunk, n);
+      n = 0;
+    }
+  }
+
+  if (chunked) {
+    XtManageChild(box);
+  }
+
+  flush_events(app, display);
+
+  double const elapsed = now() - start;
+
+  XtDestroyWidget(shell);
+  flush_events(app, display);
+  return elapsed;
+}
+
+
+/* Doubling counts up to SWEEP_MAX: items/s stays flat when the cost
+ * per widget does not depend on how many there are.
+ * */
+static void bench_swatches(XtAppContext app, Display *display)
+{
+  for (size_t count = SWEEP_MAX / 8; count <= SWEEP_MAX; count *= 2) {
+    report("widget", "XtVaCreateManagedWidget-swatches", count, 0,
+           swatches(app, display, count, 0));
+    report("widget", "XtManageChildren-swatches", count, 0,
+           swatches(app, display, count, 1));
+  }
+}
+
+
+static void bench_palette(Display *display)
+{
+  double const start = now();
+
+  PaletteInit(display, DefaultScreenOfDisplay(display));
+  XSync(display, False);
+  report("palette", "PaletteInit", PaletteSize(), 0, now() - start);
+}
+
+
+static void usage(void)
+{
+  fprintf(stderr, "Usage: xbmpwall-bench [-n count] [-s min-max] [-r rounds] [directory]\n");
+  exit(EXIT_FAILURE);
+}
+
+
+int main(int argc, char *argv[argc + 1])
+{
+  size_t count = DEFAULT_COUNT;
+  unsigned int minSize = DEFAULT_MIN_SIZE,
+               maxSize = DEFAULT_MAX_SIZE;
+  int rounds = DEFAULT_ROUNDS,
+      opt;
+
+  while ((opt = getopt(argc, argv, "n:s:r:")) != -1) {
+    switch (opt) {
+      case 'n':
+        count = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        if (sscanf(optarg, "%u-%u", &minSize, &maxSize) == 1) {
+          maxSize = minSize;
+        }
+        break;
+      case 'r':
+        rounds = atoi(optarg);
+        break;
+      default:
+        usage();
+    }
+  }
+
+  if (count == 0 || minSize == 0 || maxSize < minSize || rounds <= 0) {
+    usage();
+  }
+
+  char corpus[] = "/tmp/xbmpwall-bench.XXXXXX";
+  char const *dir = (optind < argc) ? argv[optind] : NULL;
+
+  if (dir) {
+    collect(dir);
+  } else {
+    if (!mkdtemp(corpus)) {
+      perror("mkdtemp");
+      exit(EXIT_FAILURE);
+    }
+    dir = corpus;
+    generate(dir, count, minSize, maxSize);
+  }
+
+  if (nfiles == 0) {
+    fprintf(stderr, "No .xbm files found in: %s\n", dir);
+    exit(EXIT_FAILURE);
+  }
+
+  size_t const mismatches = compare_parsers();
+
+  printf("# xbmpwall-bench %s, %zu files in %s\n", VERSION, nfiles, dir);
+  printf("# phase\tname\titems\tbytes\tseconds\titems/s\n");
+  bench_parser("libX11", read_libx11, rounds);
+  bench_parser("xbmpwall", XbmReadFile, rounds);
+  bench_parser("xbmpwall-mmap", read_mapped, rounds);
+  bench_thumbnails();
+
+  XtToolkitInitialize();
+
+  XtAppContext const app = XtCreateApplicationContext();
+  int xtArgc = 0;
+  Display *const display = XtOpenDisplay(app, NULL, "xbmpwall-bench",
+                                         "XBmpWallBench", NULL, 0,
+                                         &xtArgc, NULL);
+
+  if (display) {
+    ShmInit(display);
+    bench_upload(display);
+    bench_widgets(app, display);
+    bench_swatches(app, display);
+    bench_palette(display);
+    XtCloseDisplay(display);
+  } else {
+    printf("# no display, X phases skipped\n");
+  }
+
+  XtDestroyApplicationContext(app);
+  XbmBufferFree(&mapBuffer);
+
+  for (size_t i = 0; i < nfiles; ++i) {
+    if (dir == corpus) {
+      unlink(files[i]);
+    }
+    free(files[i]);
+    free(parsed[i].data);
+    free(parsed[i].thumb);
+  }
+
+  if (dir == corpus) {
+    rmdir(corpus);
+  }
+
+  free(files);
+  free(parsed);
+
+  return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
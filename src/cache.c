@@ -0,0 +1,290 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
+
+#include "cache.h"
+#include "thumb.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#define CACHE_DIR "xbmpwall"
+#define CACHE_MAGIC "XBC1"
+
+/* Increase when the layout of an entry changes. */
+#define CACHE_VERSION 4
+
+
+struct header {
+  char magic[4];
+  uint32_t version;
+  uint64_t size;
+  int64_t mtimeSec,
+          mtimeNsec;
+  uint32_t pathLen,
+           width,
+           height,
+           thumbWidth,
+           thumbHeight,
+           dataLen,
+           thumbSize,
+           reserved;
+  int32_t hotX,
+          hotY;
+  uint64_t hash;
+};
+
+
+static char cacheDir[PATH_MAX] = "";
+
+static unsigned int thumbSize = 0;
+
+
+/* FNV-1a, only names the entry: the full path is checked on load. */
+static uint64_t hash_path(char const *path)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+
+  for (; *path; ++path) {
+    h ^= (unsigned char)*path;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+
+static int entry_name(char const *filename, char name[static PATH_MAX])
+{
+  int const n = snprintf(name, PATH_MAX, "%s/%016llx", cacheDir,
+                         (unsigned long long)hash_path(filename));
+
+  return n > 0 && n < PATH_MAX;
+}
+
+
+static int read_full(int fd, void *data, size_t len)
+{
+  unsigned char *p = data;
+
+  while (len > 0) {
+    ssize_t const r = read(fd, p, len);
+
+    if (r == -1 && errno == EINTR) {
+      continue;
+    }
+
+    if (r <= 0) {
+      return 0;
+    }
+
+    p += r;
+    len -= (size_t)r;
+  }
+  return 1;
+}
+
+
+static int write_full(int fd, void const *data, size_t len)
+{
+  unsigned char const *p = data;
+
+  while (len > 0) {
+    ssize_t const r = write(fd, p, len);
+
+    if (r == -1 && errno == EINTR) {
+      continue;
+    }
+
+    if (r <= 0) {
+      return 0;
+    }
+
+    p += r;
+    len -= (size_t)r;
+  }
+  return 1;
+}
+
+
+static int make_dirs(char *path)
+{
+  for (char *p = path + 1; *p; ++p) {
+    if (*p != '/') {
+      continue;
+    }
+
+    *p = '\0';
+    int const ret = mkdir(path, S_IRWXU);
+    *p = '/';
+
+    if (ret == -1 && errno != EEXIST) {
+      return 0;
+    }
+  }
+  return mkdir(path, S_IRWXU) == 0 || errno == EEXIST;
+}
+
+
+void CacheInit(unsigned int size)
+{
+  char const *const xdg = getenv("XDG_CACHE_HOME");
+  char const *const home = getenv("HOME");
+  int n = -1;
+
+  thumbSize = size;
+
+  /* The XDG spec ignores relative paths. */
+  if (xdg && xdg[0] == '/') {
+    n = snprintf(cacheDir, sizeof(cacheDir), "%s/" CACHE_DIR, xdg);
+  } else if (home) {
+    n = snprintf(cacheDir, sizeof(cacheDir), "%s/.cache/" CACHE_DIR, home);
+  }
+
+  if (n <= 0 || (size_t)n >= sizeof(cacheDir) - 32 || !make_dirs(cacheDir)) {
+    cacheDir[0] = '\0';
+  }
+}
+
+
+static void fill_key(struct header *h, char const *filename,
+                     struct stat const *st)
+{
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, CACHE_MAGIC, sizeof(h->magic));
+  h->version = CACHE_VERSION;
+  h->size = (uint64_t)st->st_size;
+  h->mtimeSec = (int64_t)st->st_mtim.tv_sec;
+  h->mtimeNsec = (int64_t)st->st_mtim.tv_nsec;
+  h->pathLen = (uint32_t)strlen(filename);
+  h->thumbSize = thumbSize;
+}
+
+
+int CacheLoad(struct bitmap *bitmap, struct stat const *st)
+{
+  char const *const filename = bitmap->filename;
+  char name[PATH_MAX];
+
+  if (!cacheDir[0] || !S_ISREG(st->st_mode) || !entry_name(filename, name)) {
+    return 0;
+  }
+
+  int const fd = open(name, O_RDONLY);
+
+  if (fd == -1) {
+    return 0;
+  }
+
+  struct header key, h;
+  char path[PATH_MAX];
+  int hit = 0;
+
+  fill_key(&key, filename, st);
+
+  if (read_full(fd, &h, sizeof(h)) &&
+      memcmp(h.magic, key.magic, sizeof(h.magic)) == 0 &&
+      h.version == key.version && h.size == key.size &&
+      h.mtimeSec == key.mtimeSec && h.mtimeNsec == key.mtimeNsec &&
+      h.pathLen == key.pathLen && h.pathLen < sizeof(path) &&
+      h.thumbSize == key.thumbSize &&
+      h.width > 0 && h.height > 0 &&
+      h.thumbWidth > 0 && h.thumbWidth <= h.thumbSize &&
+      h.thumbHeight > 0 && h.thumbHeight <= h.thumbSize &&
+      h.thumbWidth <= h.width && h.thumbHeight <= h.height &&
+      h.dataLen == ((uint64_t)h.thumbWidth + 7) / 8 * h.thumbHeight &&
+      read_full(fd, path, h.pathLen) &&
+      memcmp(path, filename, h.pathLen) == 0 &&
+      XbmBufferReserve(bitmap->buffer, h.dataLen) &&
+      read_full(fd, bitmap->buffer->data, h.dataLen)) {
+
+    bitmap->width = h.width;
+    bitmap->height = h.height;
+    bitmap->thumbWidth = h.thumbWidth;
+    bitmap->thumbHeight = h.thumbHeight;
+    bitmap->hotX = h.hotX;
+    bitmap->hotY = h.hotY;
+    bitmap->hash = h.hash;
+    hit = 1;
+  }
+
+  close(fd);
+  return hit;
+}
+
+
+void CacheStore(struct bitmap const *bitmap, struct stat const *st)
+{
+  char const *const filename = bitmap->filename;
+  char name[PATH_MAX],
+       tmpName[PATH_MAX + 8];
+
+  if (!cacheDir[0] || !S_ISREG(st->st_mode) || !entry_name(filename, name)) {
+    return;
+  }
+
+  int const n = snprintf(tmpName, sizeof(tmpName), "%s.XXXXXX", name);
+
+  if (n <= 0 || (size_t)n >= sizeof(tmpName)) {
+    return;
+  }
+
+  int const fd = mkstemp(tmpName);
+
+  if (fd == -1) {
+    return;
+  }
+
+  struct header h;
+
+  fill_key(&h, filename, st);
+  h.width = bitmap->width;
+  h.height = bitmap->height;
+  h.thumbWidth = bitmap->thumbWidth;
+  h.thumbHeight = bitmap->thumbHeight;
+  h.hotX = bitmap->hotX;
+  h.hotY = bitmap->hotY;
+  h.hash = bitmap->hash;
+  h.dataLen = XBM_STRIDE(h.thumbWidth) * h.thumbHeight;
+
+  int const ok = write_full(fd, &h, sizeof(h)) &&
+                 write_full(fd, filename, h.pathLen) &&
+                 write_full(fd, bitmap->data, h.dataLen);
+
+  /* Readers never see a partial entry. */
+  if (close(fd) == 0 && ok && rename(tmpName, name) == 0) {
+    return;
+  }
+
+  unlink(tmpName);
+}
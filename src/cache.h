@@ -0,0 +1,44 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <sys/stat.h>
+
+#include "loader.h"
+
+/* Thumbnails under $XDG_CACHE_HOME/xbmpwall, one file per bitmap.
+ * An entry is valid while the path, size and mtime of its source, and
+ * the thumbnail size, match.
+ * */
+
+/* Creates the cache directory, without it the cache stays disabled.
+ * The thumbnails fit in 'thumbSize' x 'thumbSize'.
+ * */
+void CacheInit(unsigned int thumbSize);
+
+/* Returns 1 if 'bitmap->filename' (with stat 'st') has a valid entry:
+ * the sizes, hotspot and thumbnail (in 'bitmap->buffer') are filled in.
+ * Returns 0 otherwise.
+ * */
+int CacheLoad(struct bitmap *bitmap, struct stat const *st);
+
+/* Writes or replaces the entry of 'bitmap->filename'. */
+void CacheStore(struct bitmap const *bitmap, struct stat const *st);
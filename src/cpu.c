@@ -0,0 +1,41 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <unistd.h>
+
+#include "cpu.h"
+
+
+size_t CpuCount(size_t max)
+{
+  size_t n = 1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+  long const online = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (online > 0) {
+    n = (size_t)online;
+  }
+#endif
+  return n < max ? n : max;
+}
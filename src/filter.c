@@ -0,0 +1,325 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include "filter.h"
+
+/* Longer patterns are cut for the search, the names found are then
+ * checked against the whole pattern.
+ * */
+#define MAX_PATTERN 256
+
+#define EMPTY UINT32_MAX
+
+
+/* Names containing a trigram, in ascending order. */
+struct posting {
+  uint32_t trigram;
+  uint32_t count,
+           capacity;
+  uint32_t *ids;
+};
+
+
+/* Lowercase names, one after another, NUL terminated. */
+static char *names = NULL;
+
+static size_t namesUsed = 0,
+              namesCapacity = 0;
+
+static size_t *offsets = NULL;
+
+static size_t nnames = 0,
+              capNames = 0;
+
+/* Open addressing, 'capTable' is a power of two. */
+static struct posting *table = NULL;
+
+static size_t ntable = 0,
+              capTable = 0;
+
+
+static void *grow(void *p, size_t *capacity, size_t need, size_t size)
+{
+  if (need <= *capacity) {
+    return p;
+  }
+
+  size_t cap = *capacity ? *capacity : 64;
+
+  while (cap < need) {
+    cap *= 2;
+  }
+
+  p = realloc(p, cap * size);
+
+  if (!p) {
+    perror("filter");
+    exit(EXIT_FAILURE);
+  }
+
+  *capacity = cap;
+  return p;
+}
+
+
+static uint32_t trigram_of(char const *s)
+{
+  return (uint32_t)(unsigned char)s[0] << 16 |
+         (uint32_t)(unsigned char)s[1] << 8 |
+         (uint32_t)(unsigned char)s[2];
+}
+
+
+static size_t slot_of(uint32_t trigram)
+{
+  /* Fibonacci hashing */
+  return (size_t)((trigram * 2654435769u) & (capTable - 1));
+}
+
+
+static struct posting *find(uint32_t trigram)
+{
+  if (capTable == 0) {
+    return NULL;
+  }
+
+  for (size_t i = slot_of(trigram); ; i = (i + 1) & (capTable - 1)) {
+    if (table[i].trigram == EMPTY) {
+      return NULL;
+    }
+    if (table[i].trigram == trigram) {
+      return &table[i];
+    }
+  }
+}
+
+
+static struct posting *insert(uint32_t trigram)
+{
+  if ((ntable + 1) * 2 > capTable) {
+    struct posting *const old = table;
+    size_t const oldCap = capTable;
+
+    capTable = capTable ? capTable * 2 : 1024;
+    table = malloc(capTable * sizeof(*table));
+
+    if (!table) {
+      perror("filter");
+      exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < capTable; ++i) {
+      table[i].trigram = EMPTY;
+    }
+
+    for (size_t i = 0; i < oldCap; ++i) {
+      if (old[i].trigram != EMPTY) {
+        size_t k = slot_of(old[i].trigram);
+
+        while (table[k].trigram != EMPTY) {
+          k = (k + 1) & (capTable - 1);
+        }
+        table[k] = old[i];
+      }
+    }
+
+    free(old);
+  }
+
+  size_t i = slot_of(trigram);
+
+  while (table[i].trigram != EMPTY && table[i].trigram != trigram) {
+    i = (i + 1) & (capTable - 1);
+  }
+
+  if (table[i].trigram == EMPTY) {
+    table[i] = (struct posting){ .trigram = trigram };
+    ++ntable;
+  }
+  return &table[i];
+}
+
+
+void FilterAdd(char const *name)
+{
+  size_t const len = strlen(name);
+  uint32_t const id = (uint32_t)nnames;
+
+  offsets = grow(offsets, &capNames, nnames + 1, sizeof(*offsets));
+  names = grow(names, &namesCapacity, namesUsed + len + 1, 1);
+
+  char *const lower = names + namesUsed;
+
+  for (size_t i = 0; i <= len; ++i) {
+    lower[i] = (char)tolower((unsigned char)name[i]);
+  }
+
+  offsets[nnames++] = namesUsed;
+  namesUsed += len + 1;
+
+  for (size_t i = 0; i + 3 <= len; ++i) {
+    struct posting *const p = insert(trigram_of(lower + i));
+
+    /* Ids only grow, a repeated trigram is the last one. */
+    if (p->count > 0 && p->ids[p->count - 1] == id) {
+      continue;
+    }
+
+    if (p->count == p->capacity) {
+      p->capacity = p->capacity ? p->capacity * 2 : 4;
+      p->ids = realloc(p->ids, p->capacity * sizeof(*p->ids));
+
+      if (!p->ids) {
+        perror("filter");
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    p->ids[p->count++] = id;
+  }
+}
+
+
+/* 'pattern' in lowercase, cut to MAX_PATTERN - 1. */
+static void lowercase(char const *pattern, char lower[static MAX_PATTERN])
+{
+  size_t i = 0;
+
+  for (; pattern[i] && i < MAX_PATTERN - 1; ++i) {
+    lower[i] = (char)tolower((unsigned char)pattern[i]);
+  }
+  lower[i] = '\0';
+}
+
+
+/* 'name', in lowercase, contains 'pattern' in any case. */
+static int contains(char const *name, char const *pattern)
+{
+  for (;; ++name) {
+    size_t k = 0;
+
+    while (pattern[k] && name[k] == (char)tolower((unsigned char)pattern[k])) {
+      ++k;
+    }
+
+    if (!pattern[k]) {
+      return 1;
+    }
+
+    if (!name[0]) {
+      return 0;
+    }
+  }
+}
+
+
+/* 'lower' is 'pattern' from lowercase, 'cut' if it is shorter. */
+static int matches(char const *name, char const *lower,
+                   char const *pattern, int cut)
+{
+  return strstr(name, lower) != NULL && (!cut || contains(name, pattern));
+}
+
+
+int FilterMatch(size_t index, char const *pattern)
+{
+  char lower[MAX_PATTERN];
+
+  assert(index < nnames);
+
+  lowercase(pattern, lower);
+  return matches(names + offsets[index], lower, pattern,
+                 strlen(pattern) >= MAX_PATTERN);
+}
+
+
+size_t FilterSearch(char const *pattern, size_t const *within, size_t nwithin,
+                    size_t *out)
+{
+  char lower[MAX_PATTERN];
+  int const cut = strlen(pattern) >= MAX_PATTERN;
+  size_t const len = cut ? MAX_PATTERN - 1 : strlen(pattern);
+  size_t n = 0;
+
+  lowercase(pattern, lower);
+
+  /* The rarest trigram gives the fewest names to verify. */
+  struct posting const *rarest = NULL;
+
+  for (size_t i = 0; i + 3 <= len; ++i) {
+    struct posting const *const p = find(trigram_of(lower + i));
+
+    if (NULL == p) {
+      return 0;
+    }
+
+    if (!rarest || p->count < rarest->count) {
+      rarest = p;
+    }
+  }
+
+  if (within && (!rarest || nwithin <= rarest->count)) {
+    for (size_t i = 0; i < nwithin; ++i) {
+      if (matches(names + offsets[within[i]], lower, pattern, cut)) {
+        out[n++] = within[i];
+      }
+    }
+  } else if (rarest) {
+    size_t k = 0;
+
+    for (size_t i = 0; i < rarest->count; ++i) {
+      size_t const id = rarest->ids[i];
+
+      /* Both lists are sorted. */
+      if (within) {
+        while (k < nwithin && within[k] < id) {
+          ++k;
+        }
+        if (k == nwithin) {
+          break;
+        }
+        if (within[k] != id) {
+          continue;
+        }
+      }
+
+      if (matches(names + offsets[id], lower, pattern, cut)) {
+        out[n++] = id;
+      }
+    }
+  } else {
+    for (size_t i = 0; i < nnames; ++i) {
+      if (matches(names + offsets[i], lower, pattern, cut)) {
+        out[n++] = i;
+      }
+    }
+  }
+
+  return n;
+}
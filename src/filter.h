@@ -0,0 +1,43 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+
+/* Case-insensitive substring search over the grid file names.
+ *
+ * A trigram index maps each 3 byte sequence to the names that contain
+ * it, a search only verifies the names of its rarest trigram.
+ * */
+
+/* Indexes 'name' with the next number, from 0. */
+void FilterAdd(char const *name);
+
+/* Returns 1 if name 'index' contains 'pattern'. */
+int FilterMatch(size_t index, char const *pattern);
+
+/* Writes to 'out', in ascending order, the indexes of the names that
+ * contain 'pattern'. If 'within' is not NULL only those 'nwithin'
+ * sorted indexes are considered. 'out' may be 'within'.
+ * Returns how many were written.
+ * */
+size_t FilterSearch(char const *pattern, size_t const *within, size_t nwithin,
+                    size_t *out);
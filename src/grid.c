@@ -0,0 +1,951 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include <X11/Intrinsic.h>
+#include <X11/StringDefs.h>
+#include <X11/Xaw/Form.h>
+#include <X11/Xaw/Simple.h>
+#include <X11/Xaw/Scrollbar.h>
+
+#include "grid.h"
+#include "thumb.h"
+#include "stats.h"
+#include "filter.h"
+#include "shm.h"
+#include "archive.h"
+
+/* Same look as the Box of Command widgets it replaces. */
+#define SPACING 4
+#define BORDER 1
+#define HIGHLIGHT 2
+
+/* Rows above and below the view that get a bitmap in advance. */
+#define PREFETCH_ROWS 2
+
+/* Rows beyond this distance from the view release their bitmap. */
+#define RELEASE_ROWS 8
+
+#define ARENA_BLOCK (64 * 1024)
+
+/* Position of an item hidden by the filter, end of an alias chain. */
+#define HIDDEN ((size_t)-1)
+
+/* At most, passed to the hover callback. */
+#define MAX_ALIASES 16
+
+
+/* Items with the same content share the bits and the bitmap of the
+ * first one, their 'canonical'. Its aliases are chained by 'nextAlias'.
+ * */
+struct item {
+  char const *filename;
+  unsigned char *bits;
+  unsigned short width,
+                 height;
+  Pixmap bitmap;
+  size_t position,
+         canonical,
+         nextAlias,
+         lastAlias;
+  unsigned long mark;
+};
+
+struct hashed {
+  uint64_t hash;
+  size_t index;
+};
+
+/* Thumbnail bits live in big blocks instead of one malloc per item. */
+struct block {
+  struct block *next;
+  size_t used;
+  unsigned char data[];
+};
+
+
+static Widget grid = NULL,
+              scrollbar = NULL;
+
+static XtCallbackProc selectProc = NULL;
+
+static Display *display = NULL;
+
+static GC thumbGC = None,
+          borderGC = None,
+          highlightGC = None;
+
+static struct item *items = NULL;
+
+static size_t nitems = 0,
+              capItems = 0;
+
+/* The items that pass the filter, in order: cells show 'view[i]'. */
+static size_t *view = NULL,
+              *nextView = NULL;
+
+static size_t nview = 0;
+
+static char *pattern = NULL;
+
+/* Items with a bitmap in the server. */
+static size_t *uploaded = NULL;
+
+static size_t nuploaded = 0;
+
+/* Content hash to canonical item, open addressing. */
+static struct hashed *hashes = NULL;
+
+static size_t nhashes = 0,
+              capHashes = 0;
+
+/* Only canonical items are shown, see GridCollapse. */
+static Boolean collapse = False;
+
+static unsigned long markCounter = 0;
+
+static GridHoverProc hoverProc = NULL;
+
+static struct block *blocks = NULL;
+
+static unsigned int itemSize = 0,
+                    pitch = 0;
+
+static Dimension width = 0,
+                 height = 0;
+
+static int scrollY = 0;
+
+static long hover = -1,
+            pressed = -1;
+
+static Boolean updatePending = False;
+
+
+static unsigned char *arena_alloc(size_t size)
+{
+  assert(size <= ARENA_BLOCK);
+
+  if (!blocks || blocks->used + size > ARENA_BLOCK) {
+    struct block *const b = malloc(sizeof(*b) + ARENA_BLOCK);
+
+    if (!b) {
+      perror("GridAppend");
+      exit(EXIT_FAILURE);
+    }
+
+    b->next = blocks;
+    b->used = 0;
+    blocks = b;
+  }
+
+  unsigned char *const p = blocks->data + blocks->used;
+
+  blocks->used += size;
+  return p;
+}
+
+
+static size_t columns(void)
+{
+  size_t const n = (width > SPACING) ? (width - SPACING) / pitch : 0;
+
+  return n ? n : 1;
+}
+
+
+static int content_height(void)
+{
+  size_t const cols = columns();
+
+  return SPACING + (int)(((nview + cols - 1) / cols) * pitch);
+}
+
+
+static int max_scroll(void)
+{
+  int const max = content_height() - (int)height;
+
+  return max > 0 ? max : 0;
+}
+
+
+static void cell_origin(size_t i, int *x, int *y)
+{
+  size_t const cols = columns();
+
+  *x = SPACING + (int)((i % cols) * pitch);
+  *y = SPACING + (int)((i / cols) * pitch) - scrollY;
+}
+
+
+/* Items whose rows intersect [y0, y1) in window coordinates. */
+static void items_in(int y0, int y1, size_t *first, size_t *last)
+{
+  size_t const cols = columns();
+  int top = scrollY + y0 - SPACING,
+      bottom = scrollY + y1 - SPACING;
+
+  if (top < 0) {
+    top = 0;
+  }
+
+  if (bottom < 0) {
+    bottom = 0;
+  }
+
+  *first = (size_t)(top / (int)pitch) * cols;
+  *last = ((size_t)(bottom / (int)pitch) + 1) * cols;
+
+  if (*first > nview) {
+    *first = nview;
+  }
+
+  if (*last > nview) {
+    *last = nview;
+  }
+}
+
+
+/* Server side, rows are padded to 32 bits. */
+static long bitmap_bytes(struct item const *it)
+{
+  return (long)((it->width + 31) / 32 * 4) * it->height;
+}
+
+
+static void release(struct item *it)
+{
+  if (it->bitmap != None) {
+    XFreePixmap(display, it->bitmap);
+    StatsPixmap(-bitmap_bytes(it));
+    it->bitmap = None;
+  }
+}
+
+
+/* Uploads the rows around the visible cells [first, last) and
+ * releases the items that went far away or were filtered out.
+ * */
+static void materialize(size_t first, size_t last)
+{
+  size_t const cols = columns(),
+               prefetch = PREFETCH_ROWS * cols,
+               far = RELEASE_ROWS * cols;
+
+  size_t const keepBegin = first > far ? first - far : 0,
+               keepEnd = last + far < nview ? last + far : nview,
+               wantBegin = first > prefetch ? first - prefetch : 0,
+               wantEnd = last + prefetch < nview ? last + prefetch : nview;
+
+  unsigned long const mark = ++markCounter;
+  size_t kept = 0;
+
+  /* A shared bitmap stays while any of its items is near. */
+  for (size_t i = keepBegin; i < keepEnd; ++i) {
+    items[items[view[i]].canonical].mark = mark;
+  }
+
+  for (size_t i = 0; i < nuploaded; ++i) {
+    struct item *const it = &items[uploaded[i]];
+
+    if (it->mark != mark) {
+      release(it);
+    } else {
+      uploaded[kept++] = uploaded[i];
+    }
+  }
+
+  nuploaded = kept;
+
+  Window const root = RootWindowOfScreen(XtScreen(grid));
+
+  for (size_t i = wantBegin; i < wantEnd; ++i) {
+    size_t const c = items[view[i]].canonical;
+    struct item *const it = &items[c];
+
+    if (it->bitmap == None) {
+      it->bitmap = ShmCreateBitmap(display, root, it->bits,
+                                   it->width, it->height);
+      StatsPixmap(bitmap_bytes(it));
+      uploaded[nuploaded++] = c;
+    }
+  }
+}
+
+
+static void draw_item(size_t i)
+{
+  struct item *const it = &items[items[view[i]].canonical];
+  Window const win = XtWindow(grid);
+  int x, y;
+
+  cell_origin(i, &x, &y);
+
+  XDrawRectangle(display, win, borderGC, x, y,
+                 itemSize + 2 * BORDER - 1, itemSize + 2 * BORDER - 1);
+
+  if (it->bitmap != None) {
+    XSetStipple(display, thumbGC, it->bitmap);
+    XSetTSOrigin(display, thumbGC, x + BORDER, y + BORDER);
+    XFillRectangle(display, win, thumbGC, x + BORDER, y + BORDER,
+                   itemSize, itemSize);
+  }
+
+  if ((long)i == hover) {
+    XDrawRectangle(display, win, highlightGC,
+                   x + BORDER + HIGHLIGHT / 2, y + BORDER + HIGHLIGHT / 2,
+                   itemSize - HIGHLIGHT, itemSize - HIGHLIGHT);
+  }
+}
+
+
+static void redraw(int y0, int y1)
+{
+  size_t first, last, visibleFirst, visibleLast;
+
+  items_in(0, height, &visibleFirst, &visibleLast);
+  materialize(visibleFirst, visibleLast);
+
+  items_in(y0, y1, &first, &last);
+
+  for (size_t i = first; i < last; ++i) {
+    draw_item(i);
+  }
+}
+
+
+static void update_scrollbar(void)
+{
+  int const total = content_height();
+
+  if (total <= 0 || total <= (int)height) {
+    XawScrollbarSetThumb(scrollbar, 0.0, 1.0);
+  } else {
+    XawScrollbarSetThumb(scrollbar, (float)scrollY / total,
+                         (float)height / total);
+  }
+}
+
+
+static void scroll_to(int y)
+{
+  int const max = max_scroll();
+
+  if (y > max) {
+    y = max;
+  }
+
+  if (y < 0) {
+    y = 0;
+  }
+
+  if (y == scrollY) {
+    return;
+  }
+
+  scrollY = y;
+  update_scrollbar();
+  XClearArea(display, XtWindow(grid), 0, 0, 0, 0, True);
+}
+
+
+static long item_at(int x, int y)
+{
+  if (x < SPACING || y + scrollY < SPACING) {
+    return -1;
+  }
+
+  size_t const col = (size_t)(x - SPACING) / pitch,
+               row = (size_t)(y + scrollY - SPACING) / pitch;
+
+  if (col >= columns() ||
+      (unsigned int)(x - SPACING) % pitch >= itemSize + 2 * BORDER ||
+      (unsigned int)(y + scrollY - SPACING) % pitch >= itemSize + 2 * BORDER) {
+    return -1;
+  }
+
+  size_t const i = row * columns() + col;
+
+  return i < nview ? (long)i : -1;
+}
+
+
+/* Names of the other items with the same content as 'index'. */
+static void notify_hover(size_t index)
+{
+  char const *aliases[MAX_ALIASES];
+  size_t n = 0;
+
+  for (size_t k = items[index].canonical; k != HIDDEN && n < MAX_ALIASES;
+       k = items[k].nextAlias) {
+    if (k != index) {
+      aliases[n++] = items[k].filename;
+    }
+  }
+
+  hoverProc(items[index].filename, aliases, n);
+}
+
+
+static void set_hover(long i)
+{
+  long const old = hover;
+
+  if (i == old) {
+    return;
+  }
+
+  hover = i;
+
+  if (hoverProc) {
+    if (i >= 0) {
+      notify_hover(view[i]);
+    } else {
+      hoverProc(NULL, NULL, 0);
+    }
+  }
+
+  if (old >= 0 && (size_t)old < nview) {
+    draw_item((size_t)old);
+  }
+
+  if (i >= 0) {
+    draw_item((size_t)i);
+  }
+}
+
+
+static void GridEvent(Widget w, XtPointer clientData,
+                      XEvent *event, Boolean *cont)
+{
+  (void)w;          /*UNUSED*/
+  (void)clientData; /*UNUSED*/
+  (void)cont;       /*UNUSED*/
+
+  static int damageTop = 0,
+             damageBottom = 0;
+
+  switch (event->type) {
+    case Expose:
+      if (damageBottom <= damageTop) {
+        damageTop = event->xexpose.y;
+        damageBottom = event->xexpose.y + event->xexpose.height;
+      } else {
+        if (event->xexpose.y < damageTop) {
+          damageTop = event->xexpose.y;
+        }
+        if (event->xexpose.y + event->xexpose.height > damageBottom) {
+          damageBottom = event->xexpose.y + event->xexpose.height;
+        }
+      }
+
+      if (event->xexpose.count == 0) {
+        redraw(damageTop, damageBottom);
+        damageTop = damageBottom = 0;
+      }
+      break;
+
+    case ConfigureNotify:
+      if (event->xconfigure.width != width ||
+          event->xconfigure.height != height) {
+        width = event->xconfigure.width;
+        height = event->xconfigure.height;
+
+        if (scrollY > max_scroll()) {
+          scrollY = max_scroll();
+        }
+
+        update_scrollbar();
+        XClearArea(display, XtWindow(grid), 0, 0, 0, 0, True);
+      }
+      break;
+
+    case MotionNotify:
+      set_hover(item_at(event->xmotion.x, event->xmotion.y));
+      break;
+
+    case LeaveNotify:
+      set_hover(-1);
+      pressed = -1;
+      break;
+
+    case ButtonPress:
+      if (event->xbutton.button == Button4) {
+        scroll_to(scrollY - (int)pitch);
+      } else if (event->xbutton.button == Button5) {
+        scroll_to(scrollY + (int)pitch);
+      } else if (event->xbutton.button == Button1) {
+        pressed = item_at(event->xbutton.x, event->xbutton.y);
+      }
+      break;
+
+    case ButtonRelease:
+      if (event->xbutton.button == Button1 && pressed >= 0 &&
+          pressed == item_at(event->xbutton.x, event->xbutton.y)) {
+        selectProc(grid, (XtPointer)items[view[pressed]].filename, NULL);
+      }
+      pressed = -1;
+      break;
+  }
+}
+
+
+static void Scroll(Widget w, XtPointer clientData, XtPointer callData)
+{
+  (void)w;          /*UNUSED*/
+  (void)clientData; /*UNUSED*/
+
+  scroll_to(scrollY + (int)(long)callData);
+}
+
+
+static void Jump(Widget w, XtPointer clientData, XtPointer callData)
+{
+  (void)w;          /*UNUSED*/
+  (void)clientData; /*UNUSED*/
+
+  scroll_to((int)(*(float *)callData * content_height()));
+}
+
+
+/* Runs once the event queue is empty, after a batch of GridAppend. */
+static Boolean Update(XtPointer clientData)
+{
+  (void)clientData; /*UNUSED*/
+
+  updatePending = False;
+  update_scrollbar();
+  return True;
+}
+
+
+Widget GridCreate(Widget form, Widget fromVert,
+                  Dimension w, Dimension h,
+                  unsigned int size, XtCallbackProc select)
+{
+  assert(grid == NULL && select != NULL);
+
+  itemSize = size;
+  pitch = size + 2 * BORDER + SPACING;
+  selectProc = select;
+
+  grid = XtVaCreateManagedWidget("grid", simpleWidgetClass,
+      form,
+      XtNfromVert, fromVert,
+      XtNwidth, w,
+      XtNheight, h,
+      XtNtop, XawChainTop,
+      XtNbottom, XawChainBottom,
+      XtNleft, XawChainLeft,
+      XtNright, XawChainRight,
+      NULL);
+
+  scrollbar = XtVaCreateManagedWidget("scrollbar", scrollbarWidgetClass,
+      form,
+      XtNfromVert, fromVert,
+      XtNfromHoriz, grid,
+      XtNheight, h,
+      XtNtop, XawChainTop,
+      XtNbottom, XawChainBottom,
+      XtNleft, XawChainRight,
+      XtNright, XawChainRight,
+      NULL);
+
+  width = w;
+  height = h;
+
+  XtAddCallback(scrollbar, XtNscrollProc, Scroll, NULL);
+  XtAddCallback(scrollbar, XtNjumpProc, Jump, NULL);
+
+  XtAddEventHandler(grid,
+      ExposureMask | StructureNotifyMask | PointerMotionMask |
+      LeaveWindowMask | ButtonPressMask | ButtonReleaseMask,
+      False, GridEvent, NULL);
+
+  display = XtDisplay(grid);
+
+  Screen *const screen = XtScreen(grid);
+  Window const root = RootWindowOfScreen(screen);
+  Pixel const fg = BlackPixelOfScreen(screen);
+  Pixel const bg = WhitePixelOfScreen(screen);
+  Pixel foreground;
+
+  XtVaGetValues(form, XtNforeground, &foreground, NULL);
+
+  thumbGC = XCreateGC(display, root,
+      GCForeground | GCBackground | GCFillStyle,
+      &(XGCValues){ .foreground = fg, .background = bg,
+                    .fill_style = FillOpaqueStippled });
+
+  borderGC = XCreateGC(display, root, GCForeground,
+      &(XGCValues){ .foreground = fg });
+
+  highlightGC = XCreateGC(display, root, GCForeground | GCLineWidth,
+      &(XGCValues){ .foreground = foreground, .line_width = HIGHLIGHT });
+
+  return grid;
+}
+
+
+static int compare_index(void const *a, void const *b)
+{
+  size_t const x = *(size_t const *)a,
+               y = *(size_t const *)b;
+
+  return (x > y) - (x < y);
+}
+
+
+/* Items that pass 'pattern' into 'nextView', returns how many. */
+static size_t search(Boolean narrow)
+{
+  size_t n;
+
+  if (!pattern) {
+    n = 0;
+
+    for (size_t i = 0; i < nitems; ++i) {
+      if (!collapse || items[i].canonical == i) {
+        nextView[n++] = i;
+      }
+    }
+    return n;
+  }
+
+  if (!collapse) {
+    /* Typing narrows the current view. */
+    return narrow ? FilterSearch(pattern, view, nview, nextView)
+                  : FilterSearch(pattern, NULL, 0, nextView);
+  }
+
+  /* Any name of a collapsed entry shows it. */
+  size_t const found = FilterSearch(pattern, NULL, 0, nextView);
+  unsigned long const mark = ++markCounter;
+
+  n = 0;
+
+  for (size_t i = 0; i < found; ++i) {
+    size_t const c = items[nextView[i]].canonical;
+
+    if (items[c].mark != mark) {
+      items[c].mark = mark;
+      nextView[n++] = c;
+    }
+  }
+
+  qsort(nextView, n, sizeof(*nextView), compare_index);
+  return n;
+}
+
+
+/* Replaces the view, only the cells in sight that change are repainted. */
+static void set_view(size_t n)
+{
+  if (XtIsRealized(grid)) {
+    set_hover(-1);
+  }
+
+  hover = pressed = -1;
+
+  for (size_t i = 0; i < nview; ++i) {
+    items[view[i]].position = HIDDEN;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    items[nextView[i]].position = i;
+  }
+
+  size_t *const old = view;
+  size_t const nold = nview;
+
+  view = nextView;
+  nextView = old;
+  nview = n;
+
+  if (!XtIsRealized(grid)) {
+    return;
+  }
+
+  update_scrollbar();
+
+  if (scrollY > max_scroll()) {
+    scroll_to(max_scroll());
+    return;
+  }
+
+  size_t first, last;
+
+  items_in(0, height, &first, &last);
+
+  size_t const cols = columns();
+  size_t const end = ((size_t)(scrollY + height) / pitch + 1) * cols;
+
+  for (size_t i = first; i < end && (i < nold || i < nview); ++i) {
+    if (i < nold && i < nview && old[i] == view[i]) {
+      continue;
+    }
+
+    int x, y;
+
+    cell_origin(i, &x, &y);
+    XClearArea(display, XtWindow(grid), x, y, pitch, pitch, True);
+  }
+}
+
+
+static void refilter(void)
+{
+  set_view(search(False));
+}
+
+
+void GridFilter(char const *text)
+{
+  assert(grid != NULL);
+
+  if (text && text[0] == '\0') {
+    text = NULL;
+  }
+
+  if ((!text && !pattern) || (text && pattern && strcmp(text, pattern) == 0)) {
+    return;
+  }
+
+  Boolean const narrow = text && pattern && strstr(text, pattern);
+
+  free(pattern);
+  pattern = text ? strdup(text) : NULL;
+  set_view(search(narrow));
+}
+
+
+void GridCollapse(Boolean duplicates)
+{
+  assert(grid != NULL);
+
+  if (collapse != duplicates) {
+    collapse = duplicates;
+    refilter();
+  }
+}
+
+
+void GridHover(GridHoverProc proc)
+{
+  hoverProc = proc;
+}
+
+
+/* The first item with the same content as 'bits', or HIDDEN. */
+static size_t find_same(uint64_t hash, unsigned char const *bits,
+                        unsigned int w, unsigned int h)
+{
+  if (capHashes == 0) {
+    return HIDDEN;
+  }
+
+  for (size_t i = hash & (capHashes - 1); hashes[i].index != HIDDEN;
+       i = (i + 1) & (capHashes - 1)) {
+    struct item const *const it = &items[hashes[i].index];
+
+    /* The thumbnails must match too, against collisions. */
+    if (hashes[i].hash == hash && it->width == w && it->height == h &&
+        memcmp(it->bits, bits, XBM_STRIDE(w) * h) == 0) {
+      return hashes[i].index;
+    }
+  }
+  return HIDDEN;
+}
+
+
+static void add_hash(uint64_t hash, size_t index)
+{
+  if ((nhashes + 1) * 2 > capHashes) {
+    struct hashed *const old = hashes;
+    size_t const oldCap = capHashes;
+
+    capHashes = capHashes ? capHashes * 2 : 1024;
+    hashes = malloc(capHashes * sizeof(*hashes));
+
+    if (!hashes) {
+      perror("GridAppend");
+      exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < capHashes; ++i) {
+      hashes[i].index = HIDDEN;
+    }
+
+    nhashes = 0;
+
+    for (size_t i = 0; i < oldCap; ++i) {
+      if (old[i].index != HIDDEN) {
+        add_hash(old[i].hash, old[i].index);
+      }
+    }
+
+    free(old);
+  }
+
+  size_t i = hash & (capHashes - 1);
+
+  while (hashes[i].index != HIDDEN) {
+    i = (i + 1) & (capHashes - 1);
+  }
+
+  hashes[i] = (struct hashed){ .hash = hash, .index = index };
+  ++nhashes;
+}
+
+
+/* What the filter sees: the last component of the path, or of the
+ * entry name for archive entries.
+ * */
+static char const *base_name(char const *filename)
+{
+  char const *const slash = strrchr(filename, '/');
+  char const *const base = slash ? slash + 1 : filename;
+  char const *const entry = strstr(base, ARCHIVE_SUFFIX ":");
+
+  return entry ? entry + sizeof(ARCHIVE_SUFFIX) : base;
+}
+
+
+void GridAppend(char const *filename, unsigned char const *bits,
+                unsigned int w, unsigned int h, uint64_t hash)
+{
+  assert(grid != NULL);
+  assert(w <= itemSize && h <= itemSize);
+
+  if (nitems == capItems) {
+    capItems = capItems ? capItems * 2 : 256;
+    items = realloc(items, capItems * sizeof(*items));
+    view = realloc(view, capItems * sizeof(*view));
+    nextView = realloc(nextView, capItems * sizeof(*nextView));
+    uploaded = realloc(uploaded, capItems * sizeof(*uploaded));
+
+    if (!items || !view || !nextView || !uploaded) {
+      perror("GridAppend");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  size_t const size = XBM_STRIDE(w) * h;
+  size_t const index = nitems;
+  size_t const same = find_same(hash, bits, w, h);
+  struct item *const it = &items[index];
+
+  it->filename = filename;
+  it->width = (unsigned short)w;
+  it->height = (unsigned short)h;
+  it->bitmap = None;
+  it->position = HIDDEN;
+  it->nextAlias = HIDDEN;
+  it->lastAlias = index;
+  it->mark = 0;
+
+  if (same == HIDDEN) {
+    it->canonical = index;
+    it->bits = arena_alloc(size);
+    memcpy(it->bits, bits, size);
+    add_hash(hash, index);
+  } else {
+    struct item *const c = &items[same];
+
+    it->canonical = same;
+    it->bits = c->bits;
+    items[c->lastAlias].nextAlias = index;
+    c->lastAlias = index;
+  }
+
+  FilterAdd(base_name(filename));
+  ++nitems;
+
+  if (collapse && same != HIDDEN) {
+    /* Its name may bring the canonical item into the filtered view. */
+    if (pattern && items[same].position == HIDDEN &&
+        FilterMatch(index, pattern)) {
+      refilter();
+    }
+    return;
+  }
+
+  if (pattern && !FilterMatch(index, pattern)) {
+    return;
+  }
+
+  size_t const i = nview++;
+
+  view[i] = index;
+  it->position = i;
+
+  if (!XtIsRealized(grid)) {
+    return;
+  }
+
+  int x, y;
+
+  cell_origin(i, &x, &y);
+
+  /* Only what lands in view is drawn, through an Expose. */
+  if (y < (int)height && y + (int)pitch > 0) {
+    XClearArea(display, XtWindow(grid), x, y, pitch, pitch, True);
+  }
+
+  if (!updatePending) {
+    updatePending = True;
+    XtAppAddWorkProc(XtWidgetToApplicationContext(grid), Update, NULL);
+  }
+}
+
+
+void GridTint(Pixel fg, Pixel bg)
+{
+  XGCValues values;
+
+  XGetGCValues(display, thumbGC, GCForeground | GCBackground, &values);
+
+  if (values.foreground == fg && values.background == bg) {
+    return;
+  }
+
+  XChangeGC(display, thumbGC, GCForeground | GCBackground,
+            &(XGCValues){ .foreground = fg, .background = bg });
+
+  /* The fill is opaque, drawing over the cells is enough. */
+  if (XtIsRealized(grid)) {
+    redraw(0, (int)height);
+  }
+}
+
+
+size_t GridCount(void)
+{
+  return nitems;
+}
@@ -0,0 +1,71 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <X11/Intrinsic.h>
+
+/* Virtualized grid of bitmap thumbnails.
+ *
+ * The grid is a single window: thumbnails are kept as client-side bits
+ * and only the rows in view (plus a prefetch margin) have a bitmap in
+ * the server. Rows that scroll far away release theirs.
+ * */
+
+/* Creates the grid and its scrollbar in 'form', below 'fromVert'.
+ * 'select' is called with the file name as client data when an item
+ * is clicked.
+ * */
+Widget GridCreate(Widget form, Widget fromVert,
+                  Dimension width, Dimension height,
+                  unsigned int itemSize, XtCallbackProc select);
+
+/* Adds a thumbnail of 'width' x 'height', 'bits' are copied.
+ * Items with the same 'hash' (XbmHash of the full bitmap) share the
+ * bits and the server bitmap of the first one.
+ * */
+void GridAppend(char const *filename, unsigned char const *bits,
+                unsigned int width, unsigned int height, uint64_t hash);
+
+/* Shows a single entry for the items with the same content. */
+void GridCollapse(Boolean duplicates);
+
+/* Called with the file under the pointer and the other files with the
+ * same content, or with NULL when the pointer leaves the items.
+ * */
+typedef void (*GridHoverProc)(char const *filename,
+                              char const *const aliases[], size_t naliases);
+
+void GridHover(GridHoverProc proc);
+
+/* Shows only the items whose file name contains 'text', ignoring case.
+ * NULL or "" shows them all. Only the cells that change are repainted.
+ * */
+void GridFilter(char const *text);
+
+/* Draws the thumbnails with 'fg' for the 1 bits and 'bg' for the 0
+ * bits, as the wallpaper would be. Only the items in view are redrawn.
+ * */
+void GridTint(Pixel fg, Pixel bg);
+
+/* Number of items in the grid. */
+size_t GridCount(void);
@@ -0,0 +1,442 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "loader.h"
+#include "xbm.h"
+#include "cache.h"
+#include "thumb.h"
+#include "archive.h"
+#include "cpu.h"
+
+/* Bytes of a file decoded at once, the full bitmap is never in memory. */
+#define STRIP_SIZE (64 << 10)
+
+/* Decoded bitmaps waiting for the main thread, per worker. */
+#define BUFFERS_PER_THREAD 4
+
+/* Items are stored in chunks that never move, so a worker can decode
+ * one while more are added.
+ * */
+#define CHUNK_ITEMS 1024
+
+#define ITEM(i) (&chunks[(i) / CHUNK_ITEMS]->items[(i) % CHUNK_ITEMS])
+
+#define DONE(i) (chunks[(i) / CHUNK_ITEMS]->done[(i) % CHUNK_ITEMS])
+
+
+struct chunk {
+  struct bitmap items[CHUNK_ITEMS];
+  /* Set by the worker once the item is decoded. */
+  unsigned char done[CHUNK_ITEMS];
+};
+
+static struct chunk **chunks = NULL;
+
+static size_t nchunks = 0,
+              capChunks = 0;
+
+static size_t nitems = 0,
+              nextItem = 0;
+
+/* LoaderEnd was called, no more items. */
+static int ended = 0;
+
+static pthread_t threads[MAX_THREADS];
+
+static size_t nthreads = 0;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER,
+                      condBuffer = PTHREAD_COND_INITIALIZER;
+
+/* The buffers are allocated once and recycled, they only hold
+ * thumbnails, so there is no heap churn per file.
+ * */
+static XbmBuffer buffers[MAX_THREADS * BUFFERS_PER_THREAD];
+
+static XbmBuffer *freeBuffers[MAX_THREADS * BUFFERS_PER_THREAD];
+
+static size_t nbuffers = 0,
+              nfreeBuffers = 0;
+
+/* Strips of the decoding when there are no threads. */
+static XbmBuffer mainScratch;
+
+static unsigned int thumbSize = 0;
+
+/* A byte is written each time a bitmap is decoded, see LoaderFd. */
+static int pipeFds[2] = {-1, -1};
+
+
+/* Scales the full bitmap 'bits' into the buffer of 'b'. */
+static int make_thumbnail(struct bitmap *b, unsigned char const *bits)
+{
+  ThumbSize(b->width, b->height, thumbSize, &b->thumbWidth, &b->thumbHeight);
+
+  size_t const size = XBM_STRIDE(b->thumbWidth) * b->thumbHeight;
+
+  if (!XbmBufferReserve(b->buffer, size)) {
+    b->status = BitmapNoMemory;
+    return 0;
+  }
+
+  if (b->thumbWidth == b->width && b->thumbHeight == b->height) {
+    memcpy(b->buffer->data, bits, size);
+  } else {
+    ThumbScale(bits, b->width, b->height,
+               b->buffer->data, b->thumbWidth, b->thumbHeight);
+  }
+
+  b->data = b->buffer->data;
+  return 1;
+}
+
+
+struct strips {
+  struct bitmap *b;
+  int noMemory;
+  XbmHashState hash;
+  ThumbScaler scaler;
+};
+
+
+/* Hash and thumbnail, one strip of the file at a time. */
+static int Strip(void *closure, unsigned char const *bits,
+                 unsigned int width, unsigned int height,
+                 unsigned int y, unsigned int rows)
+{
+  struct strips *const s = closure;
+  struct bitmap *const b = s->b;
+  size_t const stride = XBM_STRIDE(width);
+
+  if (y == 0) {
+    ThumbSize(width, height, thumbSize, &b->thumbWidth, &b->thumbHeight);
+
+    if (!XbmBufferReserve(b->buffer, XBM_STRIDE(b->thumbWidth) * b->thumbHeight)) {
+      s->noMemory = 1;
+      return 0;
+    }
+
+    if (b->thumbWidth != width || b->thumbHeight != height) {
+      ThumbScaleBegin(&s->scaler, width, height, b->buffer->data,
+                      b->thumbWidth, b->thumbHeight);
+    }
+
+    XbmHashBegin(&s->hash, width, height);
+  }
+
+  XbmHashUpdate(&s->hash, bits, stride * rows);
+
+  if (b->thumbWidth == width && b->thumbHeight == height) {
+    memcpy(b->buffer->data + y * stride, bits, stride * rows);
+  } else {
+    ThumbScaleRows(&s->scaler, bits, rows);
+  }
+  return 1;
+}
+
+
+/* 'scratch' receives the strips of the file, only the thumbnail is kept. */
+static void decode(struct bitmap *b, XbmBuffer *scratch)
+{
+  b->data = NULL;
+
+  /* Already decoded, straight from the archive mapping. */
+  unsigned char const *const packed = ArchiveFind(b->filename,
+                                        &b->width, &b->height,
+                                        &b->hotX, &b->hotY);
+
+  if (packed) {
+    b->status = BitmapSuccess;
+    b->hash = XbmHash(packed, b->width, b->height);
+    make_thumbnail(b, packed);
+    return;
+  }
+
+  struct stat st;
+  int const statOk = (stat(b->filename, &st) == 0);
+
+  if (statOk && CacheLoad(b, &st)) {
+    b->status = BitmapSuccess;
+    b->data = b->buffer->data;
+    return;
+  }
+
+  struct strips strips = { .b = b };
+
+  b->status = XbmStreamFile(b->filename, scratch, STRIP_SIZE, Strip, &strips,
+                            &b->width, &b->height, &b->hotX, &b->hotY);
+
+  if (strips.noMemory) {
+    b->status = BitmapNoMemory;
+  }
+
+  if (b->status != BitmapSuccess) {
+    return;
+  }
+
+  b->hash = XbmHashEnd(&strips.hash);
+  b->data = b->buffer->data;
+
+  if (statOk) {
+    CacheStore(b, &st);
+  }
+}
+
+
+static void *Worker(void *arg)
+{
+  (void)arg; /*UNUSED*/
+
+  XbmBuffer scratch = {0};
+
+  pthread_mutex_lock(&mutex);
+
+  for (;;) {
+    /* Waiting for a buffer bounds how far the workers run ahead. */
+    while (nextItem < nitems ? nfreeBuffers == 0 : !ended) {
+      pthread_cond_wait(&condBuffer, &mutex);
+    }
+
+    if (nextItem == nitems) {
+      break;
+    }
+
+    size_t const i = nextItem++;
+    struct bitmap *const b = ITEM(i);
+
+    b->buffer = freeBuffers[--nfreeBuffers];
+    pthread_mutex_unlock(&mutex);
+
+    decode(b, &scratch);
+
+    pthread_mutex_lock(&mutex);
+    DONE(i) = 1;
+    pthread_cond_broadcast(&cond);
+
+    /* A full pipe already has a wake-up in it. */
+    while (write(pipeFds[1], "", 1) == -1 && errno == EINTR);
+  }
+
+  pthread_mutex_unlock(&mutex);
+  XbmBufferFree(&scratch);
+  return NULL;
+}
+
+
+void LoaderStart(unsigned int size)
+{
+  assert(chunks == NULL);
+
+  nitems = nextItem = 0;
+  ended = 0;
+  thumbSize = size;
+
+  if (pipeFds[0] == -1) {
+    if (pipe(pipeFds) == -1) {
+      perror("LoaderStart: pipe");
+      exit(EXIT_FAILURE);
+    }
+
+    fcntl(pipeFds[0], F_SETFL, O_NONBLOCK);
+    fcntl(pipeFds[1], F_SETFL, O_NONBLOCK);
+  }
+
+  size_t const ncpu = CpuCount(MAX_THREADS);
+
+  nbuffers = (ncpu ? ncpu : 1) * BUFFERS_PER_THREAD;
+
+  for (nfreeBuffers = 0; nfreeBuffers < nbuffers; ++nfreeBuffers) {
+    freeBuffers[nfreeBuffers] = &buffers[nfreeBuffers];
+  }
+
+  for (nthreads = 0; nthreads < ncpu; ++nthreads) {
+    if (pthread_create(&threads[nthreads], NULL, Worker, NULL) != 0) {
+      break;
+    }
+  }
+}
+
+
+void LoaderAdd(char const *const filenames[], size_t count)
+{
+  pthread_mutex_lock(&mutex);
+
+  for (size_t i = 0; i < count; ++i, ++nitems) {
+    if (nitems == nchunks * CHUNK_ITEMS) {
+      if (nchunks == capChunks) {
+        capChunks = capChunks ? capChunks * 2 : 16;
+        chunks = realloc(chunks, capChunks * sizeof(*chunks));
+        assert(chunks != NULL);
+      }
+
+      chunks[nchunks] = calloc(1, sizeof(**chunks));
+      assert(chunks[nchunks] != NULL);
+      ++nchunks;
+    }
+
+    *ITEM(nitems) = (struct bitmap){ .filename = filenames[i] };
+  }
+
+  pthread_cond_broadcast(&condBuffer);
+  pthread_mutex_unlock(&mutex);
+
+  /* Without workers nobody else wakes the main thread. */
+  if (nthreads == 0 && count > 0) {
+    while (write(pipeFds[1], "", 1) == -1 && errno == EINTR);
+  }
+}
+
+
+void LoaderEnd(void)
+{
+  pthread_mutex_lock(&mutex);
+  ended = 1;
+  pthread_cond_broadcast(&condBuffer);
+  pthread_mutex_unlock(&mutex);
+
+  /* The main thread may be waiting for the last items. */
+  while (write(pipeFds[1], "", 1) == -1 && errno == EINTR);
+}
+
+
+size_t LoaderCount(int *isEnded)
+{
+  pthread_mutex_lock(&mutex);
+
+  size_t const count = nitems;
+
+  *isEnded = ended;
+  pthread_mutex_unlock(&mutex);
+  return count;
+}
+
+
+void LoaderRelease(struct bitmap *bitmap)
+{
+  assert(bitmap->buffer != NULL);
+
+  pthread_mutex_lock(&mutex);
+  freeBuffers[nfreeBuffers++] = bitmap->buffer;
+  pthread_cond_signal(&condBuffer);
+  pthread_mutex_unlock(&mutex);
+
+  bitmap->buffer = NULL;
+  bitmap->data = NULL;
+}
+
+
+/* Called with 'mutex' held. */
+static void decode_here(size_t index)
+{
+  /* Without threads, decode on the caller's thread. */
+  if (nthreads == 0 && !DONE(index)) {
+    assert(nfreeBuffers > 0);
+
+    ITEM(index)->buffer = freeBuffers[--nfreeBuffers];
+    decode(ITEM(index), &mainScratch);
+    DONE(index) = 1;
+  }
+}
+
+
+struct bitmap *LoaderWait(size_t index)
+{
+  pthread_mutex_lock(&mutex);
+
+  assert(index < nitems);
+
+  decode_here(index);
+
+  while (!DONE(index)) {
+    pthread_cond_wait(&cond, &mutex);
+  }
+
+  struct bitmap *const b = ITEM(index);
+
+  pthread_mutex_unlock(&mutex);
+  return b;
+}
+
+
+struct bitmap *LoaderPoll(size_t index)
+{
+  pthread_mutex_lock(&mutex);
+
+  assert(index < nitems);
+
+  decode_here(index);
+
+  struct bitmap *const b = DONE(index) ? ITEM(index) : NULL;
+
+  pthread_mutex_unlock(&mutex);
+  return b;
+}
+
+
+int LoaderFd(void)
+{
+  return pipeFds[0];
+}
+
+
+void LoaderStop(void)
+{
+  assert(ended);
+
+  for (size_t i = 0; i < nthreads; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+
+  nthreads = 0;
+
+  for (size_t i = 0; i < nbuffers; ++i) {
+    XbmBufferFree(&buffers[i]);
+  }
+
+  nbuffers = nfreeBuffers = 0;
+  XbmBufferFree(&mainScratch);
+
+  for (size_t i = 0; i < nchunks; ++i) {
+    free(chunks[i]);
+  }
+
+  free(chunks);
+  chunks = NULL;
+  nchunks = capChunks = 0;
+  nitems = nextItem = 0;
+}
@@ -0,0 +1,81 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xbm.h"
+
+/* A bitmap file decoded by the worker pool.
+ * 'status' takes the values of XReadBitmapFileData.
+ * 'width' and 'height' are those of the file, 'data' holds only the
+ * thumbnail and points into a pooled buffer, see LoaderRelease.
+ * */
+struct bitmap {
+  char const *filename;
+  unsigned char *data;
+  XbmBuffer *buffer;
+  unsigned int width,
+               height,
+               thumbWidth,
+               thumbHeight;
+  int hotX,
+      hotY,
+      status;
+  uint64_t hash; /* XbmHash of the full bitmap */
+};
+
+
+/* Starts the background threads, they decode the bitmaps given to
+ * LoaderAdd in order. Thumbnails fit in 'thumbSize' x 'thumbSize'.
+ * */
+void LoaderStart(unsigned int thumbSize);
+
+/* Queues 'filenames[0..count-1]', the next indexes, from any thread.
+ * The strings must outlive the loader.
+ * */
+void LoaderAdd(char const *const filenames[], size_t count);
+
+/* No more bitmaps will be added, from any thread. Also wakes LoaderFd. */
+void LoaderEnd(void);
+
+/* Number of bitmaps added so far, 'ended' is set after LoaderEnd. */
+size_t LoaderCount(int *ended);
+
+/* Blocks until 'bitmaps[index]' has been decoded. */
+struct bitmap *LoaderWait(size_t index);
+
+/* Same as LoaderWait, but returns NULL instead of blocking. */
+struct bitmap *LoaderPoll(size_t index);
+
+/* Readable each time a worker finishes a bitmap, for XtAppAddInput.
+ * The caller drains it. Without threads it is written when bitmaps are
+ * added, LoaderPoll then decodes on the calling thread and never
+ * returns NULL.
+ * */
+int LoaderFd(void);
+
+/* Gives the buffer of 'bitmap' back to the pool, 'data' is no longer valid. */
+void LoaderRelease(struct bitmap *bitmap);
+
+/* Waits for all threads to finish, after LoaderEnd. */
+void LoaderStop(void);
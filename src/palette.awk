@@ -0,0 +1,33 @@
+# Generates rgbtable.h from hexcolors.h: the colors are deduplicated,
+# keeping the first occurrence, and packed as 0xRRGGBB.
+# Usage: awk -f palette.awk hexcolors.h > rgbtable.h
+
+BEGIN {
+  n = 0
+}
+
+/^"#[0-9A-Fa-f]+"/ {
+  hex = toupper(substr($0, 3, 6))
+  if (!(hex in seen)) {
+    seen[hex] = 1
+    colors[n++] = hex
+  }
+}
+
+END {
+  print "/* Generated from hexcolors.h by palette.awk, do not edit. */"
+  print "#ifndef RGBTABLE_H"
+  print "#define RGBTABLE_H"
+  print ""
+  printf "#define PALETTE_SIZE %d\n\n", n
+  print "static uint32_t const paletteRGB[PALETTE_SIZE] = {"
+  for (i = 0; i < n; i++) {
+    printf "%s0x%s,", (i % 8 == 0) ? "  " : " ", colors[i]
+    if (i % 8 == 7 || i == n - 1) {
+      printf "\n"
+    }
+  }
+  print "};"
+  print ""
+  print "#endif"
+}
@@ -0,0 +1,301 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#ifdef HAVE_XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif
+
+#include "palette.h"
+#include "stats.h"
+#include "rgbtable.h"
+
+
+static Display *display = NULL;
+
+static Screen *screen = NULL;
+
+static Visual *visual = NULL;
+
+static unsigned long pixels[PALETTE_SIZE];
+
+/* Colors outside the table, only read from a saved state. */
+#define MAX_EXTRA 8
+
+static struct extra {
+  uint32_t rgb;
+  unsigned long pixel;
+  /* 0 for a nearest_mono fallback, which owns no reference. */
+  unsigned char allocated;
+} extras[MAX_EXTRA];
+
+static size_t nextras = 0,
+              nextExtra = 0;
+
+
+struct channel {
+  int shift;
+  unsigned long max;
+};
+
+static struct channel red,
+                      green,
+                      blue;
+
+
+static struct channel make_channel(unsigned long mask)
+{
+  struct channel c = {0, 0};
+
+  if (mask == 0) {
+    return c;
+  }
+
+  while (!(mask & 1)) {
+    mask >>= 1;
+    ++c.shift;
+  }
+
+  c.max = mask;
+  return c;
+}
+
+
+static unsigned long scale(struct channel c, unsigned int value)
+{
+  return ((value * c.max + 127) / 255) << c.shift;
+}
+
+
+static int is_true_color(Visual const *v)
+{
+  return v && v->class == TrueColor;
+}
+
+
+/* Used when the colormap is full. */
+static unsigned long nearest_mono(Screen *screen, uint32_t rgb)
+{
+  unsigned int const gray = (((rgb >> 16) & 0xFF) + ((rgb >> 8) & 0xFF) +
+                             (rgb & 0xFF)) / 3;
+
+  return gray >= 0x80 ? WhitePixelOfScreen(screen) : BlackPixelOfScreen(screen);
+}
+
+
+#ifdef HAVE_XCB
+
+/* All the requests go out before the first reply is read.
+ * 'allocated[i]', when not NULL, is set if 'out[i]' was allocated.
+ * */
+static void alloc_colors(Display *dpy, Screen *screen,
+                         uint32_t const rgb[], unsigned long out[],
+                         unsigned char allocated[], size_t count)
+{
+  xcb_connection_t *const conn = XGetXCBConnection(dpy);
+  xcb_colormap_t const cmap = (xcb_colormap_t)DefaultColormapOfScreen(screen);
+  xcb_alloc_color_cookie_t *const cookies = malloc(count * sizeof(*cookies));
+
+  assert(cookies != NULL);
+
+  for (size_t i = 0; i < count; ++i) {
+    cookies[i] = xcb_alloc_color(conn, cmap,
+                                 (uint16_t)(((rgb[i] >> 16) & 0xFF) * 0x101),
+                                 (uint16_t)(((rgb[i] >> 8) & 0xFF) * 0x101),
+                                 (uint16_t)((rgb[i] & 0xFF) * 0x101));
+  }
+
+  StatsRoundTrip();
+
+  for (size_t i = 0; i < count; ++i) {
+    xcb_alloc_color_reply_t *const reply =
+      xcb_alloc_color_reply(conn, cookies[i], NULL);
+
+    out[i] = reply ? reply->pixel : nearest_mono(screen, rgb[i]);
+
+    if (allocated) {
+      allocated[i] = (reply != NULL);
+    }
+    free(reply);
+  }
+
+  free(cookies);
+}
+
+#else
+
+static void alloc_colors(Display *dpy, Screen *screen,
+                         uint32_t const rgb[], unsigned long out[],
+                         unsigned char allocated[], size_t count)
+{
+  for (size_t i = 0; i < count; ++i) {
+    XColor color = {
+      .red = (unsigned short)(((rgb[i] >> 16) & 0xFF) * 0x101),
+      .green = (unsigned short)(((rgb[i] >> 8) & 0xFF) * 0x101),
+      .blue = (unsigned short)((rgb[i] & 0xFF) * 0x101),
+      .flags = DoRed | DoGreen | DoBlue,
+    };
+
+    StatsRoundTrip();
+
+    Status const ok = XAllocColor(dpy, DefaultColormapOfScreen(screen), &color);
+
+    out[i] = ok ? color.pixel : nearest_mono(screen, rgb[i]);
+
+    if (allocated) {
+      allocated[i] = (ok != 0);
+    }
+  }
+}
+
+#endif
+
+
+void PaletteAllocPixels(Display *dpy, Screen *screen,
+                        uint32_t const rgb[], unsigned long out[], size_t count)
+{
+  Visual const *const v = DefaultVisualOfScreen(screen);
+
+  if (!is_true_color(v)) {
+    /* PseudoColor and the other visuals need the server. */
+    alloc_colors(dpy, screen, rgb, out, NULL, count);
+    return;
+  }
+
+  struct channel const r = make_channel(v->red_mask),
+                       g = make_channel(v->green_mask),
+                       b = make_channel(v->blue_mask);
+
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = scale(r, (rgb[i] >> 16) & 0xFF) | scale(g, (rgb[i] >> 8) & 0xFF) |
+             scale(b, rgb[i] & 0xFF);
+  }
+}
+
+
+unsigned long PaletteRGBToPixel(uint32_t rgb)
+{
+  assert(display != NULL);
+
+  if (is_true_color(visual)) {
+    return scale(red, (rgb >> 16) & 0xFF) | scale(green, (rgb >> 8) & 0xFF) |
+           scale(blue, rgb & 0xFF);
+  }
+
+  /* Each allocation takes a colormap reference, reuse the ones held. */
+  for (size_t i = 0; i < PALETTE_SIZE; ++i) {
+    if (paletteRGB[i] == rgb) {
+      return pixels[i];
+    }
+  }
+
+  for (size_t i = 0; i < nextras; ++i) {
+    if (extras[i].rgb == rgb) {
+      return extras[i].pixel;
+    }
+  }
+
+  struct extra *const e = &extras[nextExtra];
+
+  if (nextras < MAX_EXTRA) {
+    ++nextras;
+  } else if (e->allocated) {
+    XFreeColors(display, DefaultColormapOfScreen(screen), &e->pixel, 1, 0);
+  }
+
+  nextExtra = (nextExtra + 1) % MAX_EXTRA;
+  e->rgb = rgb;
+  alloc_colors(display, screen, &rgb, &e->pixel, &e->allocated, 1);
+  return e->pixel;
+}
+
+
+void PaletteInit(Display *dpy, Screen *scr)
+{
+  display = dpy;
+  screen = scr;
+  visual = DefaultVisualOfScreen(screen);
+
+  if (is_true_color(visual)) {
+    red = make_channel(visual->red_mask);
+    green = make_channel(visual->green_mask);
+    blue = make_channel(visual->blue_mask);
+  }
+
+  PaletteAllocPixels(display, screen, paletteRGB, pixels, PALETTE_SIZE);
+}
+
+
+size_t PaletteSize(void)
+{
+  return PALETTE_SIZE;
+}
+
+
+uint32_t PaletteRGB(size_t index)
+{
+  assert(index < PALETTE_SIZE);
+  return paletteRGB[index];
+}
+
+
+unsigned long PalettePixel(size_t index)
+{
+  assert(index < PALETTE_SIZE);
+  return pixels[index];
+}
+
+
+void PaletteFormat(uint32_t rgb, char hex[static 8])
+{
+  snprintf(hex, 8, "#%06X", (unsigned int)(rgb & 0xFFFFFF));
+}
+
+
+int PaletteParse(char const *hex, uint32_t *rgb)
+{
+  if (!hex || hex[0] != '#' || strlen(hex) != 7) {
+    return 0;
+  }
+
+  uint32_t value = 0;
+
+  for (int i = 1; i < 7; ++i) {
+    if (!isxdigit((unsigned char)hex[i])) {
+      return 0;
+    }
+    value = value << 4 | (uint32_t)(isdigit((unsigned char)hex[i]) ?
+        hex[i] - '0' : (tolower((unsigned char)hex[i]) - 'a' + 10));
+  }
+
+  *rgb = value;
+  return 1;
+}
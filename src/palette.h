@@ -0,0 +1,60 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <X11/Xlib.h>
+
+/* The color table of hexcolors.h, deduplicated and packed as 0xRRGGBB
+ * at build time (see palette.awk).
+ * */
+
+/* Resolves the pixel values of the whole table. On TrueColor visuals
+ * they are computed from the visual masks, without server requests.
+ * */
+void PaletteInit(Display *display, Screen *screen);
+
+size_t PaletteSize(void);
+
+uint32_t PaletteRGB(size_t index);
+
+unsigned long PalettePixel(size_t index);
+
+/* Pixel for any 0xRRGGBB color, also those not in the table. Colors of
+ * the table are not allocated again; a few others are kept, the oldest
+ * is freed to make room.
+ * */
+unsigned long PaletteRGBToPixel(uint32_t rgb);
+
+/* Pixels of 'rgb[0..count-1]' on any display. On other visuals than
+ * TrueColor the colors are allocated in one round trip when XCB is
+ * available.
+ * */
+void PaletteAllocPixels(Display *display, Screen *screen,
+                        uint32_t const rgb[], unsigned long pixels[], size_t count);
+
+/* Formats 'rgb' as "#RRGGBB". */
+void PaletteFormat(uint32_t rgb, char hex[static 8]);
+
+/* Parses "#RRGGBB", returns 0 if 'hex' is not in that form. */
+int PaletteParse(char const *hex, uint32_t *rgb);
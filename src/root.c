@@ -0,0 +1,204 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <assert.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+#include "root.h"
+#include "stats.h"
+#include "palette.h"
+#include "shm.h"
+
+
+/* Last pixmap published by this process, it is never killed. */
+static Pixmap ownPixmap = None;
+
+static Display *atomsDisplay = NULL;
+
+static Atom atoms[2];
+
+/* Set by ApplyError while RootApplyPermanent waits for the server. */
+static Bool applyFailed = False;
+
+
+static int IgnoreError(Display *display, XErrorEvent *event)
+{
+  (void)display; /*UNUSED*/
+  (void)event;   /*UNUSED*/
+  return 0;
+}
+
+
+static int ApplyError(Display *display, XErrorEvent *event)
+{
+  (void)display; /*UNUSED*/
+  (void)event;   /*UNUSED*/
+  applyFailed = True;
+  return 0;
+}
+
+
+static Pixmap get_pixmap_property(Display *display, Window root, Atom atom)
+{
+  Atom type = None;
+  int format = 0;
+  unsigned long nitems = 0,
+                after = 0;
+  unsigned char *data = NULL;
+  Pixmap pixmap = None;
+
+  StatsRoundTrip();
+
+  if (XGetWindowProperty(display, root, atom, 0, 1, False, XA_PIXMAP,
+                         &type, &format, &nitems, &after, &data) == Success &&
+      type == XA_PIXMAP && format == 32 && nitems == 1 && data) {
+    pixmap = *(Pixmap *)data;
+  }
+
+  if (data) {
+    XFree(data);
+  }
+  return pixmap;
+}
+
+
+/* Esetroot convention: when both properties name the same pixmap, it
+ * belongs to a client kept with RetainPermanent, kill it to free it.
+ * */
+static void kill_previous(Display *display, Window root,
+                          Atom atomRoot, Atom atomEsetroot)
+{
+  Pixmap const eroot = get_pixmap_property(display, root, atomEsetroot);
+
+  if (eroot == None || eroot == ownPixmap) {
+    return;
+  }
+
+  if (get_pixmap_property(display, root, atomRoot) != eroot) {
+    return;
+  }
+
+  /* The client may be gone already. */
+  XErrorHandler const old = XSetErrorHandler(IgnoreError);
+
+  XKillClient(display, eroot);
+  XSync(display, False);
+  StatsRoundTrip();
+  XSetErrorHandler(old);
+}
+
+
+Pixmap RootRender(Display *display, Screen *screen,
+                  unsigned char const *bits,
+                  unsigned int width, unsigned int height,
+                  unsigned long fg, unsigned long bg)
+{
+  Window const root = RootWindowOfScreen(screen);
+
+  Pixmap const tile = ShmCreateBitmap(display, root, bits, width, height);
+
+  Pixmap const pixmap = XCreatePixmap(display, root,
+                                      WidthOfScreen(screen),
+                                      HeightOfScreen(screen),
+                                      DefaultDepthOfScreen(screen));
+
+  GC const gc = XCreateGC(display, pixmap,
+      GCForeground | GCBackground | GCFillStyle | GCStipple,
+      &(XGCValues){ .foreground = fg, .background = bg,
+                    .fill_style = FillOpaqueStippled, .stipple = tile });
+
+  XFillRectangle(display, pixmap, gc, 0, 0,
+                 WidthOfScreen(screen), HeightOfScreen(screen));
+
+  XFreeGC(display, gc);
+  XFreePixmap(display, tile);
+  return pixmap;
+}
+
+
+void RootApply(Display *display, Screen *screen, Pixmap pixmap)
+{
+  static char *names[2] = { "_XROOTPMAP_ID", "ESETROOT_PMAP_ID" };
+
+  Window const root = RootWindowOfScreen(screen);
+
+  if (atomsDisplay != display) {
+    XInternAtoms(display, names, 2, False, atoms);
+    StatsRoundTrip();
+    atomsDisplay = display;
+  }
+
+  kill_previous(display, root, atoms[0], atoms[1]);
+
+  XChangeProperty(display, root, atoms[0], XA_PIXMAP, 32, PropModeReplace,
+                  (unsigned char *)&pixmap, 1);
+  XChangeProperty(display, root, atoms[1], XA_PIXMAP, 32, PropModeReplace,
+                  (unsigned char *)&pixmap, 1);
+
+  XSetWindowBackgroundPixmap(display, root, pixmap);
+  XClearWindow(display, root);
+
+  ownPixmap = pixmap;
+  XFlush(display);
+}
+
+
+int RootApplyPermanent(Display *display,
+                       unsigned char const *bits,
+                       unsigned int width, unsigned int height,
+                       uint32_t fg, uint32_t bg)
+{
+  Screen *const screen = DefaultScreenOfDisplay(display);
+  unsigned long pixels[2];
+  XErrorHandler const old = XSetErrorHandler(ApplyError);
+
+  applyFailed = False;
+
+  /* The colors are allocated by this connection, so they stay too. */
+  PaletteAllocPixels(display, screen, (uint32_t[]){ fg, bg }, pixels, 2);
+
+  Pixmap const pixmap = RootRender(display, screen, bits, width, height,
+                                   pixels[0], pixels[1]);
+
+  RootApply(display, screen, pixmap);
+
+  XSync(display, False);
+  StatsRoundTrip();
+  XSetErrorHandler(old);
+
+  Bool const ok = !applyFailed;
+
+  /* On error nothing is kept. */
+  if (ok) {
+    XSetCloseDownMode(display, RetainPermanent);
+  }
+
+  XCloseDisplay(display);
+
+  atomsDisplay = NULL;
+  ownPixmap = None;
+  return ok;
+}
@@ -0,0 +1,52 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <X11/Xlib.h>
+
+/* Root window wallpaper, without xsetroot. */
+
+/* Renders 'bits' ('width' x 'height') tiled over the whole screen,
+ * 1 bits in 'fg' and 0 bits in 'bg'. The server does the tiling.
+ * */
+Pixmap RootRender(Display *display, Screen *screen,
+                  unsigned char const *bits,
+                  unsigned int width, unsigned int height,
+                  unsigned long fg, unsigned long bg);
+
+/* Sets 'pixmap' as the root background and publishes it in
+ * _XROOTPMAP_ID and ESETROOT_PMAP_ID. A pixmap retained by another
+ * client is killed, 'pixmap' itself still belongs to the caller: the
+ * server keeps its own reference for the background.
+ * */
+void RootApply(Display *display, Screen *screen, Pixmap pixmap);
+
+/* Same as RootRender + RootApply, but the resources of 'display'
+ * outlive this process. 'display' must be a connection of its own,
+ * it is closed.
+ * Returns 0 if the server reported an error, then nothing is kept.
+ * */
+int RootApplyPermanent(Display *display,
+                       unsigned char const *bits,
+                       unsigned int width, unsigned int height,
+                       uint32_t fg, uint32_t bg);
@@ -0,0 +1,265 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "rotate.h"
+#include "root.h"
+#include "palette.h"
+#include "archive.h"
+#include "xbm.h"
+
+
+static int stopFds[2] = {-1, -1};
+
+
+static void Stop(int sig)
+{
+  (void)sig; /*UNUSED*/
+
+  int const saved = errno;
+
+  while (write(stopFds[1], "", 1) == -1 && errno == EINTR);
+  errno = saved;
+}
+
+
+static void catch_signals(void)
+{
+  if (pipe(stopFds) == -1) {
+    perror("RotateRun: pipe");
+    exit(EXIT_FAILURE);
+  }
+
+  fcntl(stopFds[0], F_SETFL, O_NONBLOCK);
+  fcntl(stopFds[1], F_SETFL, O_NONBLOCK);
+
+  struct sigaction sa;
+
+  sa.sa_handler = Stop;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = 0;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGHUP, &sa, NULL);
+}
+
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* Fisher-Yates. The first one is not 'last', so no bitmap is shown
+ * twice in a row across rounds.
+ * */
+static void shuffle_order(size_t order[], size_t count, size_t last)
+{
+  for (size_t i = count - 1; i > 0; --i) {
+    size_t const j = (size_t)rand() % (i + 1);
+    size_t const t = order[i];
+
+    order[i] = order[j];
+    order[j] = t;
+  }
+
+  if (count > 1 && order[0] == last) {
+    order[0] = order[count - 1];
+    order[count - 1] = last;
+  }
+}
+
+
+static Pixmap render(Display *display, char const *filename,
+                     unsigned long fg, unsigned long bg)
+{
+  XbmBuffer bits = {0};
+  unsigned int width, height;
+  int hotX, hotY;
+
+  Screen *const screen = DefaultScreenOfDisplay(display);
+
+  /* The tiling starts at 0,0: nothing past the screen is seen. */
+  if (ArchiveMapClip(filename, &bits, (unsigned int)WidthOfScreen(screen),
+                     (unsigned int)HeightOfScreen(screen),
+                     &width, &height, &hotX, &hotY) != BitmapSuccess) {
+    fprintf(stderr, "Error reading the bitmap file: %s\n", filename);
+    return None;
+  }
+
+  Pixmap const pixmap = RootRender(display, screen, bits.data, width, height,
+                                   fg, bg);
+
+  XbmBufferFree(&bits);
+  return pixmap;
+}
+
+
+/* Sleeps until 'deadline', returns 0 if asked to stop. */
+static int sleep_until(Display *display, double deadline)
+{
+  struct pollfd fds[2] = {
+    { .fd = stopFds[0], .events = POLLIN },
+    { .fd = ConnectionNumber(display), .events = POLLIN },
+  };
+
+  for (;;) {
+    /* Nothing is selected, but errors and the like must be read. */
+    while (XPending(display)) {
+      XEvent event;
+
+      XNextEvent(display, &event);
+    }
+
+    double const left = deadline - now();
+
+    if (left <= 0) {
+      return 1;
+    }
+
+    int const timeout = left > 86400 ? 86400000 : (int)(left * 1000) + 1;
+
+    if (poll(fds, 2, timeout) == -1 && errno != EINTR) {
+      perror("RotateRun: poll");
+      exit(EXIT_FAILURE);
+    }
+
+    if (fds[0].revents & POLLIN) {
+      return 0;
+    }
+  }
+}
+
+
+void RotateRun(Display *display, char *const files[], size_t count,
+               unsigned int interval, int shuffle, uint32_t fg, uint32_t bg,
+               void (*applied)(char const *, uint32_t, uint32_t))
+{
+  Screen *const screen = DefaultScreenOfDisplay(display);
+  unsigned long pixels[2];
+
+  /* Kept with the pixmaps by RetainPermanent, only the two in use. */
+  PaletteAllocPixels(display, screen, (uint32_t[]){ fg, bg }, pixels, 2);
+
+  size_t *const order = malloc(count * sizeof(*order));
+
+  if (NULL == order) {
+    perror("RotateRun: malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    order[i] = i;
+  }
+
+  if (shuffle) {
+    srand((unsigned int)time(NULL) ^ (unsigned int)getpid());
+    shuffle_order(order, count, count);
+  }
+
+  catch_signals();
+
+  Pixmap shown = None;
+  size_t shownIndex = count,
+         pos = 0,
+         failures = 0;
+  double deadline = now();
+
+  for (;;) {
+    size_t const index = order[pos];
+
+    if (++pos == count) {
+      pos = 0;
+
+      if (shuffle) {
+        shuffle_order(order, count, index);
+      }
+    }
+
+    if (index == shownIndex) {
+      /* Nothing else to show. */
+      failures = 0;
+
+      if (!sleep_until(display, deadline)) {
+        break;
+      }
+
+      deadline = now() + interval;
+      continue;
+    }
+
+    /* Rendered while the previous one was on screen. */
+    Pixmap const next = render(display, files[index], pixels[0], pixels[1]);
+
+    if (None == next) {
+      if (++failures == count) {
+        break;
+      }
+      continue;
+    }
+
+    failures = 0;
+
+    if (!sleep_until(display, deadline)) {
+      XFreePixmap(display, next);
+      break;
+    }
+
+    RootApply(display, screen, next);
+
+    if (shown != None) {
+      XFreePixmap(display, shown);
+    }
+
+    shown = next;
+    shownIndex = index;
+    deadline = now() + interval;
+
+    if (applied) {
+      applied(files[index], fg, bg);
+    }
+  }
+
+  free(order);
+
+  if (None == shown) {
+    exit(EXIT_FAILURE);
+  }
+
+  /* Same as on exit of the GUI: the wallpaper outlives the process. */
+  XSetCloseDownMode(display, RetainPermanent);
+  XCloseDisplay(display);
+}
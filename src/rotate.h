@@ -0,0 +1,40 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <X11/Xlib.h>
+
+/* Slideshow without a GUI: every 'interval' seconds the next bitmap of
+ * 'files' goes on the root window, in order or shuffled.
+ *
+ * The next root pixmap is decoded and rendered right after each change,
+ * so the change itself only publishes it. Between changes the process
+ * sleeps in poll(). Ends on SIGINT, SIGTERM or SIGHUP, leaving the
+ * wallpaper on screen. Only the pixels of 'fg' and 'bg' are allocated.
+ *
+ * 'applied' is called after each change.
+ * */
+void RotateRun(Display *display, char *const files[], size_t count,
+               unsigned int interval, int shuffle, uint32_t fg, uint32_t bg,
+               void (*applied)(char const *filename, uint32_t fg, uint32_t bg));
@@ -0,0 +1,578 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+/* d_type */
+#define _DEFAULT_SOURCE
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#include "scan.h"
+#include "cpu.h"
+
+/* Walks are bound by the disk, fewer threads than the loader. */
+#define MAX_WALKERS 16
+
+/* Directories waiting in the queue keep their descriptor open,
+ * past this they are opened again from the path.
+ * */
+#define MAX_OPEN_DIRS 256
+
+#define EXTENSION ".xbm"
+
+
+/* A directory of the walk. Its files are given out in the order of
+ * their paths, so a directory waits for those before it.
+ * */
+struct node {
+  struct node *parent;
+  char *path;
+  /* Until it is walked, see push. */
+  int fd;
+  /* Files and subdirectories, in the order of their paths. 'children'
+   * is NULL for the files. The files before 'next' are given out.
+   * */
+  char **paths;
+  struct node **children;
+  size_t count,
+         next;
+  int walked;
+};
+
+/* An entry of a directory while it is read. */
+struct entry {
+  char *path;
+  struct node *child;
+};
+
+/* A growing array of strings. */
+struct list {
+  char **items;
+  size_t count,
+         capacity;
+};
+
+
+static struct node **queue = NULL;
+
+static size_t nqueue = 0,
+              queueCapacity = 0,
+              nopen = 0;
+
+/* Workers inside a directory, they may still push more. */
+static size_t nbusy = 0;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/* The first directory with files not given out yet. */
+static struct node *cursor = NULL;
+
+/* Set by ScanStart, gets the bitmaps as soon as their turn comes.
+ * Without it they go to 'collected'.
+ * */
+static ScanProc sink = NULL;
+
+static struct list *collected = NULL;
+
+
+static void list_add(struct list *list, char *item)
+{
+  if (list->count == list->capacity) {
+    list->capacity = list->capacity ? list->capacity * 2 : 64;
+    list->items = realloc(list->items, list->capacity * sizeof(*list->items));
+    assert(list->items != NULL);
+  }
+  list->items[list->count++] = item;
+}
+
+
+static char *join(char const *dir, char const *name)
+{
+  /* The root is the only directory that ends in '/'. */
+  size_t const dlen = strcmp(dir, "/") == 0 ? 0 : strlen(dir);
+  size_t const nlen = strlen(name);
+  char *const path = malloc(dlen + nlen + 2);
+
+  assert(path != NULL);
+
+  memcpy(path, dir, dlen);
+  path[dlen] = '/';
+  memcpy(path + dlen + 1, name, nlen + 1);
+  return path;
+}
+
+
+static int has_extension(char const *name)
+{
+  size_t const len = strlen(name);
+  size_t const elen = sizeof(EXTENSION) - 1;
+
+  return len > elen && strcmp(name + len - elen, EXTENSION) == 0;
+}
+
+
+/* Called with 'mutex' held. */
+static void push(struct node *node)
+{
+  if (nqueue == queueCapacity) {
+    queueCapacity = queueCapacity ? queueCapacity * 2 : 64;
+    queue = realloc(queue, queueCapacity * sizeof(*queue));
+    assert(queue != NULL);
+  }
+
+  if (node->fd >= 0 && nopen >= MAX_OPEN_DIRS) {
+    close(node->fd);
+    node->fd = -1;
+  }
+
+  if (node->fd >= 0) {
+    ++nopen;
+  }
+
+  queue[nqueue++] = node;
+  pthread_cond_signal(&cond);
+}
+
+
+/* A directory sorts as its path with a '/', as the paths below it. */
+static int compare_entries(void const *a, void const *b)
+{
+  struct entry const *const x = a,
+                     *const y = b;
+  char const *p = x->path,
+             *q = y->path;
+
+  while (*p && *p == *q) {
+    ++p;
+    ++q;
+  }
+
+  int const c = *p ? (unsigned char)*p : (x->child ? '/' : 0);
+  int const d = *q ? (unsigned char)*q : (y->child ? '/' : 0);
+
+  return c - d;
+}
+
+
+static void free_node(struct node *node)
+{
+  free(node->paths);
+  free(node->children);
+  free(node->path);
+  free(node);
+}
+
+
+/* Gives out the files whose turn has come, a directory that is not
+ * walked yet stops it. Called with 'mutex' held.
+ * */
+static void advance(void)
+{
+  while (cursor && cursor->walked) {
+    struct node *const node = cursor;
+    size_t const first = node->next;
+
+    while (node->next < node->count && !node->children[node->next]) {
+      ++node->next;
+    }
+
+    for (size_t i = first; !sink && i < node->next; ++i) {
+      list_add(collected, node->paths[i]);
+    }
+
+    if (sink && node->next > first) {
+      sink(&node->paths[first], node->next - first);
+    }
+
+    if (node->next < node->count) {
+      cursor = node->children[node->next++];
+      continue;
+    }
+
+    /* Everything below it is out. */
+    cursor = node->parent;
+    free_node(node);
+  }
+}
+
+
+/* Reads one directory: subdirectories go to the queue, the bitmaps
+ * wait for their turn in 'node'. The entries are opened relative to
+ * the directory.
+ * */
+static void walk(struct node *node)
+{
+  if (node->fd < 0) {
+    node->fd = open(node->path, O_RDONLY | O_DIRECTORY);
+  }
+
+  DIR *const d = (node->fd >= 0) ? fdopendir(node->fd) : NULL;
+  struct entry *entries = NULL;
+  size_t count = 0,
+         capacity = 0;
+
+  if (NULL == d) {
+    if (node->fd >= 0) {
+      close(node->fd);
+    }
+    fprintf(stderr, "Error reading the directory: %s\n", node->path);
+  }
+
+  struct dirent *entry;
+
+  while (d && (entry = readdir(d)) != NULL) {
+    char const *const name = entry->d_name;
+
+    if (name[0] == '.' && (name[1] == '\0' ||
+        (name[1] == '.' && name[2] == '\0'))) {
+      continue;
+    }
+
+    int isDir = 0,
+        isFile = 0;
+
+#ifdef DT_UNKNOWN
+    if (entry->d_type == DT_DIR) {
+      isDir = 1;
+    } else if (entry->d_type == DT_REG) {
+      isFile = has_extension(name);
+    } else if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+#endif
+    {
+      struct stat st;
+      /* Links to files are followed, links to directories are not. */
+      if (fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+        if (S_ISDIR(st.st_mode)) {
+          isDir = 1;
+        } else if (has_extension(name)) {
+          isFile = S_ISREG(st.st_mode) ||
+                  (S_ISLNK(st.st_mode) && fstatat(dirfd(d), name, &st, 0) == 0 &&
+                   S_ISREG(st.st_mode));
+        }
+      }
+    }
+
+    if (!isDir && !isFile) {
+      continue;
+    }
+
+    if (count == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      entries = realloc(entries, capacity * sizeof(*entries));
+      assert(entries != NULL);
+    }
+
+    struct entry *const e = &entries[count++];
+
+    e->path = join(node->path, name);
+    e->child = NULL;
+
+    if (isDir) {
+      e->child = calloc(1, sizeof(*e->child));
+      assert(e->child != NULL);
+
+      e->child->parent = node;
+      e->child->path = e->path;
+      e->child->fd = openat(dirfd(d), name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+    }
+  }
+
+  if (d) {
+    closedir(d);
+  }
+
+  qsort(entries, count, sizeof(*entries), compare_entries);
+
+  node->paths = malloc((count ? count : 1) * sizeof(*node->paths));
+  node->children = malloc((count ? count : 1) * sizeof(*node->children));
+  node->count = count;
+
+  assert(node->paths != NULL && node->children != NULL);
+
+  for (size_t i = 0; i < count; ++i) {
+    node->paths[i] = entries[i].path;
+    node->children[i] = entries[i].child;
+  }
+
+  free(entries);
+
+  pthread_mutex_lock(&mutex);
+
+  /* The queue is a stack, the first subdirectory is walked first. */
+  for (size_t i = count; i-- > 0;) {
+    if (node->children[i]) {
+      push(node->children[i]);
+    }
+  }
+
+  node->walked = 1;
+  advance();
+  pthread_mutex_unlock(&mutex);
+}
+
+
+static void *Walker(void *arg)
+{
+  (void)arg; /*UNUSED*/
+
+  pthread_mutex_lock(&mutex);
+
+  for (;;) {
+    while (nqueue == 0 && nbusy > 0) {
+      pthread_cond_wait(&cond, &mutex);
+    }
+
+    if (nqueue == 0) {
+      /* Nothing queued and nobody left to queue more. */
+      pthread_cond_broadcast(&cond);
+      break;
+    }
+
+    struct node *const node = queue[--nqueue];
+
+    if (node->fd >= 0) {
+      --nopen;
+    }
+
+    ++nbusy;
+    pthread_mutex_unlock(&mutex);
+
+    walk(node);
+
+    pthread_mutex_lock(&mutex);
+    --nbusy;
+
+    if (nbusy == 0 && nqueue == 0) {
+      pthread_cond_broadcast(&cond);
+    }
+  }
+
+  pthread_mutex_unlock(&mutex);
+  return NULL;
+}
+
+
+/* All the '*.xbm' below 'path', sorted, to the sink or to 'files'. */
+static void scan_directory(int fd, char *path, struct list *files)
+{
+  size_t const nthreads = CpuCount(MAX_WALKERS);
+  pthread_t threads[MAX_WALKERS];
+  size_t started = 0;
+  struct node *const root = calloc(1, sizeof(*root));
+
+  assert(root != NULL);
+
+  root->path = path;
+  root->fd = fd;
+
+  pthread_mutex_lock(&mutex);
+  cursor = root;
+  collected = files;
+  push(root);
+  pthread_mutex_unlock(&mutex);
+
+  for (; started < nthreads; ++started) {
+    if (pthread_create(&threads[started], NULL, Walker, NULL) != 0) {
+      break;
+    }
+  }
+
+  if (started == 0) {
+    Walker(NULL);
+  }
+
+  for (size_t i = 0; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+
+  assert(cursor == NULL);
+}
+
+
+/* 'path' as absolute, without "." and ".." components or repeated and
+ * trailing slashes. Symbolic links are kept, only the text changes.
+ * */
+static char *absolute(char const *path, char const *cwd)
+{
+  char *const abs = (path[0] == '/') ? strdup(path) : join(cwd, path);
+
+  assert(abs != NULL);
+
+  /* In place, 'out' never passes 'in'. */
+  char *out = abs;
+  char const *in = abs;
+
+  while (*in) {
+    while (*in == '/') {
+      ++in;
+    }
+
+    size_t const len = strcspn(in, "/");
+
+    if (len == 2 && in[0] == '.' && in[1] == '.') {
+      while (out > abs && *--out != '/');
+    } else if (len > 0 && !(len == 1 && in[0] == '.')) {
+      *out++ = '/';
+      memmove(out, in, len);
+      out += len;
+    }
+
+    in += len;
+  }
+
+  if (out == abs) {
+    *out++ = '/';
+  }
+
+  *out = '\0';
+  return abs;
+}
+
+
+struct start {
+  char **paths;
+  int *fds;
+  size_t count;
+};
+
+
+static void *Scanner(void *arg)
+{
+  struct start *const s = arg;
+
+  /* One argument after another, in order. */
+  for (size_t i = 0; i < s->count; ++i) {
+    if (s->fds[i] >= 0) {
+      scan_directory(s->fds[i], s->paths[i], NULL);
+    } else {
+      sink(&s->paths[i], 1);
+    }
+  }
+
+  sink(NULL, 0);
+
+  free(s->paths);
+  free(s->fds);
+  free(s);
+  return NULL;
+}
+
+
+int ScanStart(char *const paths[], size_t count, ScanProc proc)
+{
+  char cwd[PATH_MAX];
+
+  if (NULL == getcwd(cwd, sizeof(cwd))) {
+    perror("getcwd");
+    return 0;
+  }
+
+  struct start *const s = malloc(sizeof(*s));
+
+  assert(s != NULL);
+
+  s->paths = malloc((count ? count : 1) * sizeof(*s->paths));
+  s->fds = malloc((count ? count : 1) * sizeof(*s->fds));
+  s->count = count;
+
+  assert(s->paths != NULL && s->fds != NULL);
+
+  /* Only the arguments are checked here, the walk is in background. */
+  for (size_t i = 0; i < count; ++i) {
+    s->fds[i] = open(paths[i], O_RDONLY | O_DIRECTORY);
+
+    if (s->fds[i] < 0 && errno != ENOTDIR) {
+      fprintf(stderr, "Error opening: %s\n", paths[i]);
+
+      while (i-- > 0) {
+        if (s->fds[i] >= 0) {
+          close(s->fds[i]);
+        }
+        free(s->paths[i]);
+      }
+
+      free(s->paths);
+      free(s->fds);
+      free(s);
+      return 0;
+    }
+
+    s->paths[i] = absolute(paths[i], cwd);
+  }
+
+  sink = proc;
+
+  pthread_t thread;
+
+  if (pthread_create(&thread, NULL, Scanner, s) != 0) {
+    Scanner(s);
+  } else {
+    pthread_detach(thread);
+  }
+  return 1;
+}
+
+
+char **ScanPaths(char *const paths[], size_t count, size_t *nfiles)
+{
+  char cwd[PATH_MAX];
+  struct list files = {0};
+
+  if (NULL == getcwd(cwd, sizeof(cwd))) {
+    perror("getcwd");
+    return NULL;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    int const fd = open(paths[i], O_RDONLY | O_DIRECTORY);
+
+    if (fd >= 0) {
+      scan_directory(fd, absolute(paths[i], cwd), &files);
+    } else if (errno == ENOTDIR) {
+      list_add(&files, absolute(paths[i], cwd));
+    } else {
+      fprintf(stderr, "Error opening: %s\n", paths[i]);
+      return NULL;
+    }
+  }
+
+  *nfiles = files.count;
+  return files.items;
+}
@@ -0,0 +1,45 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+
+/* Expands the command line: files are kept, directories are walked
+ * recursively in parallel and give their '*.xbm' files, sorted.
+ * All the returned paths are absolute, the array and strings are
+ * malloc'd and live until the end of the program.
+ * Returns NULL if a path can not be opened.
+ * */
+char **ScanPaths(char *const paths[], size_t count, size_t *nfiles);
+
+/* Called with the paths of ScanPaths, in the same order, in batches
+ * as soon as the directories before them are read, and once with NULL
+ * when the walk is over. Runs on the threads of the walk, one call at
+ * a time.
+ * */
+typedef void (*ScanProc)(char *const files[], size_t count);
+
+/* Same as ScanPaths, but the walk goes on in background and the
+ * bitmaps are given to 'proc' as they are found. Only the paths of
+ * the command line are checked before it returns.
+ * Returns 0 if one of them can not be opened.
+ * */
+int ScanStart(char *const paths[], size_t count, ScanProc proc);
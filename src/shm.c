@@ -0,0 +1,244 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "shm.h"
+#include "stats.h"
+#include "thumb.h"
+
+#ifdef HAVE_XSHM
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+
+/* Enough for a few hundred thumbnails between waits. */
+#define MIN_SEGMENT (64 << 10)
+
+/* Larger bitmaps are sent in bands of this size. */
+#define MAX_SEGMENT (4 << 20)
+
+#define ROUND_UP(n, m) (((n) + (m) - 1) / (m) * (m))
+
+
+static Display *shmDisplay = NULL;
+
+static XShmSegmentInfo segment = { .shmid = -1 };
+
+static size_t segmentSize = 0,
+              segmentUsed = 0;
+
+static Bool attachFailed = False;
+
+
+static int AttachError(Display *display, XErrorEvent *event)
+{
+  (void)display; /*UNUSED*/
+  (void)event;   /*UNUSED*/
+  attachFailed = True;
+  return 0;
+}
+
+
+static void detach(void)
+{
+  if (segment.shmaddr == NULL) {
+    return;
+  }
+
+  XShmDetach(shmDisplay, &segment);
+  shmdt(segment.shmaddr);
+  segment.shmaddr = NULL;
+  segmentSize = segmentUsed = 0;
+}
+
+
+/* A remote server can not attach the segment, it says so with an error. */
+static Bool attach(size_t size)
+{
+  segment.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+
+  if (segment.shmid == -1) {
+    return False;
+  }
+
+  segment.shmaddr = shmat(segment.shmid, NULL, 0);
+  segment.readOnly = True;
+
+  if (segment.shmaddr == (char *)-1) {
+    segment.shmaddr = NULL;
+    shmctl(segment.shmid, IPC_RMID, NULL);
+    return False;
+  }
+
+  XErrorHandler const old = XSetErrorHandler(AttachError);
+
+  attachFailed = False;
+  XShmAttach(shmDisplay, &segment);
+  XSync(shmDisplay, False);
+  StatsRoundTrip();
+  XSetErrorHandler(old);
+
+  /* Freed once both sides detach. */
+  shmctl(segment.shmid, IPC_RMID, NULL);
+
+  if (attachFailed) {
+    shmdt(segment.shmaddr);
+    segment.shmaddr = NULL;
+    return False;
+  }
+
+  segmentSize = size;
+  segmentUsed = 0;
+  return True;
+}
+
+
+/* Room for 'size' bytes, the images already in the segment must have
+ * been read by the server before they are overwritten.
+ * */
+static char *reserve(size_t size)
+{
+  size = (size + 15) & ~(size_t)15;
+
+  if (segmentUsed + size <= segmentSize) {
+    char *const data = segment.shmaddr + segmentUsed;
+
+    segmentUsed += size;
+    return data;
+  }
+
+  XSync(shmDisplay, False);
+  StatsRoundTrip();
+  segmentUsed = 0;
+
+  if (size > segmentSize) {
+    detach();
+
+    if (!attach(size > MIN_SEGMENT ? size : MIN_SEGMENT)) {
+      shmDisplay = NULL;
+      return NULL;
+    }
+  }
+
+  segmentUsed = size;
+  return segment.shmaddr;
+}
+
+
+void ShmInit(Display *display)
+{
+  if (shmDisplay || !XShmQueryExtension(display)) {
+    return;
+  }
+
+  shmDisplay = display;
+
+  if (!attach(MIN_SEGMENT)) {
+    shmDisplay = NULL;
+  }
+}
+
+
+Pixmap ShmCreateBitmap(Display *display, Drawable drawable,
+                       unsigned char const *bits,
+                       unsigned int width, unsigned int height)
+{
+  if (display != shmDisplay || width == 0 || height == 0) {
+    return XCreateBitmapFromData(display, drawable, (char *)bits, width, height);
+  }
+
+  size_t const stride = XBM_STRIDE(width);
+  size_t const line = XBM_STRIDE(ROUND_UP(width, 32));
+  unsigned int const band = (unsigned int)(MAX_SEGMENT / line > height ?
+                                           height : MAX_SEGMENT / line);
+
+  XImage *const image = band ? XShmCreateImage(display, NULL, 1, XYBitmap,
+                                               NULL, &segment, width, band)
+                             : NULL;
+
+  /* The server reads the rows as they are: only its bit order can be
+   * copied without converting.
+   * */
+  if (!image || image->bitmap_bit_order != LSBFirst ||
+      (image->byte_order != LSBFirst && image->bitmap_unit != 8)) {
+    if (image) {
+      XDestroyImage(image);
+    }
+    return XCreateBitmapFromData(display, drawable, (char *)bits, width, height);
+  }
+
+  Pixmap const pixmap = XCreatePixmap(display, drawable, width, height, 1);
+
+  GC const gc = XCreateGC(display, pixmap, GCForeground | GCBackground,
+                          &(XGCValues){ .foreground = 1, .background = 0 });
+
+  /* Large bitmaps go in bands that fit in the segment. */
+  for (unsigned int y = 0; y < height; y += band) {
+    unsigned int const rows = height - y < band ? height - y : band;
+
+    image->data = reserve((size_t)image->bytes_per_line * rows);
+
+    if (NULL == image->data) {
+      XFreeGC(display, gc);
+      XFreePixmap(display, pixmap);
+      XDestroyImage(image);
+      return XCreateBitmapFromData(display, drawable, (char *)bits, width, height);
+    }
+
+    for (unsigned int r = 0; r < rows; ++r) {
+      memcpy(image->data + (size_t)r * image->bytes_per_line,
+             bits + (size_t)(y + r) * stride, stride);
+    }
+
+    XShmPutImage(display, pixmap, gc, image, 0, 0, 0, (int)y, width, rows, False);
+  }
+
+  XFreeGC(display, gc);
+
+  /* The data is in the segment. */
+  image->data = NULL;
+  XDestroyImage(image);
+  return pixmap;
+}
+
+#else
+
+void ShmInit(Display *display)
+{
+  (void)display; /*UNUSED*/
+}
+
+
+Pixmap ShmCreateBitmap(Display *display, Drawable drawable,
+                       unsigned char const *bits,
+                       unsigned int width, unsigned int height)
+{
+  return XCreateBitmapFromData(display, drawable, (char *)bits, width, height);
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <X11/Xlib.h>
+
+/* Bitmap uploads through MIT-SHM.
+ *
+ * A single shared segment, grown to the largest bitmap seen up to a
+ * cap, is filled one image after another; the server is waited for
+ * only when it is full. Larger bitmaps are sent in bands.
+ *
+ * Without the extension, on a remote display or for a format we can
+ * not write, XCreateBitmapFromData is used instead.
+ * */
+
+/* Enables shared memory for 'display', the only one that uses it. */
+void ShmInit(Display *display);
+
+/* Same as XCreateBitmapFromData, 'bits' in XBM layout. */
+Pixmap ShmCreateBitmap(Display *display, Drawable drawable,
+                       unsigned char const *bits,
+                       unsigned int width, unsigned int height);
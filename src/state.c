@@ -0,0 +1,126 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
+
+#include "state.h"
+#include "palette.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+
+static int state_path(char path[static PATH_MAX])
+{
+  char const *const home = getenv("HOME");
+
+  if (NULL == home) {
+    return 0;
+  }
+
+  int const n = snprintf(path, PATH_MAX, "%s" STATE_HIDE, home);
+
+  return n > 0 && n < PATH_MAX;
+}
+
+
+int StateLoad(struct state *state)
+{
+  char path[PATH_MAX],
+       line[PATH_MAX + 16];
+
+  if (!state_path(path)) {
+    return 0;
+  }
+
+  FILE *const file = fopen(path, "r");
+
+  if (!file) {
+    return 0;
+  }
+
+  int found = 0;
+
+  state->bitmap = NULL;
+  state->fg = 0x000000;
+  state->bg = 0xFFFFFF;
+
+  while (fgets(line, sizeof(line), file)) {
+    line[strcspn(line, "\n")] = '\0';
+
+    /* The file name is the rest of the line, it may have spaces. */
+    if (strncmp(line, "bitmap ", 7) == 0 && line[7] != '\0') {
+      free(state->bitmap);
+      state->bitmap = strdup(line + 7);
+      found = (state->bitmap != NULL);
+    } else if (strncmp(line, "fg ", 3) == 0) {
+      PaletteParse(line + 3, &state->fg);
+    } else if (strncmp(line, "bg ", 3) == 0) {
+      PaletteParse(line + 3, &state->bg);
+    }
+  }
+
+  fclose(file);
+  return found;
+}
+
+
+int StateSave(struct state const *state)
+{
+  char path[PATH_MAX],
+       tmpPath[PATH_MAX + 8],
+       fg[8],
+       bg[8];
+
+  if (!state_path(path)) {
+    return 0;
+  }
+
+  snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+  FILE *const file = fopen(tmpPath, "w");
+
+  if (!file) {
+    return 0;
+  }
+
+  PaletteFormat(state->fg, fg);
+  PaletteFormat(state->bg, bg);
+
+  int ok = fprintf(file, "bitmap %s\nfg %s\nbg %s\n",
+                   state->bitmap, fg, bg) > 0;
+
+  ok = (fclose(file) == 0) && ok;
+
+  /* A login never reads half a file. */
+  if (!ok || rename(tmpPath, path) != 0) {
+    remove(tmpPath);
+    return 0;
+  }
+  return 1;
+}
@@ -0,0 +1,44 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stdint.h>
+
+/* The wallpaper to restore at login, kept in ~/.xbmpwall.state:
+ *
+ *   bitmap /path/to/file.xbm
+ *   fg #RRGGBB
+ *   bg #RRGGBB
+ * */
+
+#define STATE_HIDE "/.xbmpwall.state"
+
+struct state {
+  char *bitmap; /* malloc'd */
+  uint32_t fg,
+           bg;
+};
+
+/* Returns 0 if there is no state file or it is not valid. */
+int StateLoad(struct state *state);
+
+/* Returns 0 on error, with errno set. */
+int StateSave(struct state const *state);
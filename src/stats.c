@@ -0,0 +1,193 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include <X11/Xlibint.h>
+#include <X11/Intrinsic.h>
+
+#include "stats.h"
+
+#define MAX_PHASES 16
+
+
+struct phase {
+  char const *name;
+  double seconds;
+};
+
+struct apply {
+  char const *filename;
+  double seconds;
+  int cached;
+};
+
+
+static Boolean enabled = False;
+
+static struct phase phases[MAX_PHASES];
+
+static size_t nphases = 0;
+
+static struct apply *applies = NULL;
+
+static size_t napplies = 0,
+              capApplies = 0;
+
+static unsigned long roundTrips = 0;
+
+static unsigned long long bytesSent = 0;
+
+static long pixmapBytes = 0;
+
+static XtSignalId signalId;
+
+
+/* Sees every buffer Xlib writes to the connection. */
+static void BeforeFlush(Display *display, XExtCodes *codes,
+                        _Xconst char *data, long len)
+{
+  (void)display; /*UNUSED*/
+  (void)codes;   /*UNUSED*/
+  (void)data;    /*UNUSED*/
+
+  bytesSent += len;
+}
+
+
+static void Report(XtPointer clientData, XtSignalId *id)
+{
+  (void)clientData; /*UNUSED*/
+  (void)id;         /*UNUSED*/
+
+  StatsReport();
+}
+
+
+static void on_sigusr1(int sig)
+{
+  (void)sig; /*UNUSED*/
+
+  XtNoticeSignal(signalId);
+}
+
+
+void StatsInit(XtAppContext app, Display *display)
+{
+  XExtCodes *const codes = XAddExtension(display);
+
+  if (codes) {
+    XESetBeforeFlush(display, codes->extension, BeforeFlush);
+  }
+
+  signalId = XtAppAddSignal(app, Report, NULL);
+
+  struct sigaction sa;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_sigusr1;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGUSR1, &sa, NULL);
+
+  enabled = True;
+  atexit(StatsReport);
+}
+
+
+double StatsNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+void StatsPhase(char const *name, double start)
+{
+  if (!enabled || nphases == MAX_PHASES) {
+    return;
+  }
+
+  phases[nphases++] = (struct phase){ name, StatsNow() - start };
+}
+
+
+void StatsApply(char const *filename, double start, int cached)
+{
+  if (!enabled) {
+    return;
+  }
+
+  if (napplies == capApplies) {
+    capApplies = capApplies ? capApplies * 2 : 64;
+
+    struct apply *const tmp = realloc(applies, capApplies * sizeof(*applies));
+
+    if (!tmp) {
+      return;
+    }
+    applies = tmp;
+  }
+
+  applies[napplies++] = (struct apply){ filename, StatsNow() - start, cached };
+}
+
+
+void StatsRoundTrip(void)
+{
+  ++roundTrips;
+}
+
+
+void StatsPixmap(long bytes)
+{
+  pixmapBytes += bytes;
+}
+
+
+void StatsReport(void)
+{
+  if (!enabled) {
+    return;
+  }
+
+  fprintf(stderr, "# stats: name\tvalue\n");
+
+  for (size_t i = 0; i < nphases; ++i) {
+    fprintf(stderr, "phase\t%s\t%.6f\n", phases[i].name, phases[i].seconds);
+  }
+
+  for (size_t i = 0; i < napplies; ++i) {
+    fprintf(stderr, "apply\t%s\t%.6f\t%s\n", applies[i].filename,
+            applies[i].seconds, applies[i].cached ? "cached" : "rendered");
+  }
+
+  fprintf(stderr, "roundtrips\t%lu\n", roundTrips);
+  fprintf(stderr, "bytes-sent\t%llu\n", bytesSent);
+  fprintf(stderr, "pixmap-bytes\t%ld\n", pixmapBytes);
+}
@@ -0,0 +1,49 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <X11/Intrinsic.h>
+
+/* Runtime statistics for --stats.
+ *
+ * Everything is a no-op until StatsInit. The report goes to stderr on
+ * exit and on SIGUSR1, one tab-separated line per value.
+ * Only called from the Xt thread.
+ * */
+
+void StatsInit(XtAppContext app, Display *display);
+
+/* Monotonic clock, in seconds. */
+double StatsNow(void);
+
+/* Records the time spent in 'name' since 'start'. */
+void StatsPhase(char const *name, double start);
+
+/* Records an apply requested at 'start' that is now on screen. */
+void StatsApply(char const *filename, double start, int cached);
+
+/* Counts a request that waits for the server reply. */
+void StatsRoundTrip(void);
+
+/* Server memory of pixmaps we create (> 0) or free (< 0). */
+void StatsPixmap(long bytes);
+
+void StatsReport(void);
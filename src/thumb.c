@@ -0,0 +1,174 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "thumb.h"
+
+
+static inline unsigned int popcount64(uint64_t x)
+{
+#if defined(__GNUC__)
+  return (unsigned int)__builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (unsigned int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+
+/* Set pixels of 'row' in [x0, x1), pixel x is bit (x & 7) of byte x / 8.
+ * Whole bytes are counted 64 pixels at a time, the byte order does not
+ * matter for a population count.
+ * */
+static unsigned int count_row(unsigned char const *row,
+                              unsigned int x0, unsigned int x1)
+{
+  unsigned int const b0 = x0 >> 3,
+                     b1 = (x1 - 1) >> 3;
+  unsigned int const head = (0xFFu << (x0 & 7)) & 0xFF,
+                     tail = 0xFFu >> (7 - ((x1 - 1) & 7));
+
+  if (b0 == b1) {
+    return popcount64(row[b0] & head & tail);
+  }
+
+  unsigned int n = popcount64(row[b0] & head) + popcount64(row[b1] & tail);
+  unsigned int b = b0 + 1;
+
+  for (; b + 8 <= b1; b += 8) {
+    uint64_t word;
+    memcpy(&word, row + b, sizeof(word));
+    n += popcount64(word);
+  }
+
+  for (; b < b1; ++b) {
+    n += popcount64(row[b]);
+  }
+  return n;
+}
+
+
+void ThumbSize(unsigned int width, unsigned int height, unsigned int maxSize,
+               unsigned int *thumbWidth, unsigned int *thumbHeight)
+{
+  assert(maxSize > 0 && maxSize <= MAX_THUMB);
+
+  if (width <= maxSize && height <= maxSize) {
+    *thumbWidth = width;
+    *thumbHeight = height;
+  } else if (width >= height) {
+    *thumbWidth = maxSize;
+    *thumbHeight = (unsigned int)((unsigned long long)height * maxSize / width);
+  } else {
+    *thumbWidth = (unsigned int)((unsigned long long)width * maxSize / height);
+    *thumbHeight = maxSize;
+  }
+
+  if (*thumbWidth == 0) {
+    *thumbWidth = 1;
+  }
+
+  if (*thumbHeight == 0) {
+    *thumbHeight = 1;
+  }
+}
+
+
+void ThumbScaleBegin(ThumbScaler *scaler,
+                     unsigned int width, unsigned int height,
+                     unsigned char *dst,
+                     unsigned int thumbWidth, unsigned int thumbHeight)
+{
+  assert(thumbWidth <= width && thumbHeight <= height);
+  assert(thumbWidth <= MAX_THUMB);
+
+  scaler->width = width;
+  scaler->height = height;
+  scaler->thumbWidth = thumbWidth;
+  scaler->thumbHeight = thumbHeight;
+  scaler->dst = dst;
+  scaler->y = 0;
+  scaler->ty = 0;
+  scaler->y1 = (unsigned int)((unsigned long long)height / thumbHeight);
+
+  for (unsigned int tx = 0; tx <= thumbWidth; ++tx) {
+    scaler->x0[tx] = (unsigned int)((unsigned long long)tx * width / thumbWidth);
+  }
+
+  memset(scaler->sums, 0, thumbWidth * sizeof(scaler->sums[0]));
+  memset(dst, 0, XBM_STRIDE(thumbWidth) * thumbHeight);
+}
+
+
+void ThumbScaleRows(ThumbScaler *scaler, unsigned char const *rows,
+                    unsigned int count)
+{
+  size_t const srcStride = XBM_STRIDE(scaler->width),
+               dstStride = XBM_STRIDE(scaler->thumbWidth);
+  unsigned int const thumbWidth = scaler->thumbWidth;
+  unsigned int const *const x0 = scaler->x0;
+  uint64_t *const sums = scaler->sums;
+
+  for (unsigned int r = 0; r < count; ++r) {
+    unsigned char const *const row = rows + r * srcStride;
+
+    for (unsigned int tx = 0; tx < thumbWidth; ++tx) {
+      sums[tx] += count_row(row, x0[tx], x0[tx + 1]);
+    }
+
+    if (++scaler->y < scaler->y1) {
+      continue;
+    }
+
+    /* Last source row of thumbnail row 'ty'. */
+    unsigned int const ty = scaler->ty++;
+    unsigned int const y0 = (unsigned int)((unsigned long long)ty * scaler->height / scaler->thumbHeight);
+    unsigned char *const out = scaler->dst + ty * dstStride;
+
+    for (unsigned int tx = 0; tx < thumbWidth; ++tx) {
+      unsigned long long const area = (unsigned long long)(x0[tx + 1] - x0[tx]) * (scaler->y1 - y0);
+
+      if (2 * sums[tx] >= area) {
+        out[tx >> 3] |= (unsigned char)(1u << (tx & 7));
+      }
+    }
+
+    memset(sums, 0, thumbWidth * sizeof(sums[0]));
+    scaler->y1 = (unsigned int)((unsigned long long)(ty + 2) * scaler->height / scaler->thumbHeight);
+  }
+}
+
+
+void ThumbScale(unsigned char const *src, unsigned int width, unsigned int height,
+                unsigned char *dst, unsigned int thumbWidth, unsigned int thumbHeight)
+{
+  ThumbScaler scaler;
+
+  ThumbScaleBegin(&scaler, width, height, dst, thumbWidth, thumbHeight);
+  ThumbScaleRows(&scaler, src, height);
+}
@@ -0,0 +1,65 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stdint.h>
+
+/* Largest thumbnail side. */
+#define MAX_THUMB 256
+
+/* Bytes per row of an XBM bitmap. */
+#define XBM_STRIDE(width) (((width) + 7) / 8)
+
+/* Size of the thumbnail of a 'width' x 'height' bitmap: bitmaps that fit
+ * in 'maxSize' are kept as they are (they tile like the wallpaper),
+ * larger ones are scaled down keeping the aspect ratio.
+ * */
+void ThumbSize(unsigned int width, unsigned int height, unsigned int maxSize,
+               unsigned int *thumbWidth, unsigned int *thumbHeight);
+
+/* Area-sampled 1-bit downscale: a thumbnail pixel is set when at least
+ * half of the source pixels it covers are set.
+ * */
+void ThumbScale(unsigned char const *src, unsigned int width, unsigned int height,
+                unsigned char *dst, unsigned int thumbWidth, unsigned int thumbHeight);
+
+/* ThumbScale for a bitmap that arrives in strips, top to bottom. */
+typedef struct {
+  unsigned int width,
+               height,
+               thumbWidth,
+               thumbHeight,
+               y,  /* next source row */
+               ty, /* thumbnail row being summed */
+               y1; /* its first source row past the end */
+  unsigned int x0[MAX_THUMB + 1];
+  uint64_t sums[MAX_THUMB];
+  unsigned char *dst;
+} ThumbScaler;
+
+void ThumbScaleBegin(ThumbScaler *scaler,
+                     unsigned int width, unsigned int height,
+                     unsigned char *dst,
+                     unsigned int thumbWidth, unsigned int thumbHeight);
+
+/* Adds the next 'count' rows of the bitmap. */
+void ThumbScaleRows(ThumbScaler *scaler, unsigned char const *rows,
+                    unsigned int count);
@@ -0,0 +1,600 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "xbm.h"
+
+/* Same line limit as libX11 (RdBitF.c). */
+#define MAX_LINE 255
+
+#define DIGIT 0x10
+#define DELIM 0x20
+
+/* Hex digits carry DIGIT | value, the delimiters known by libX11 carry
+ * DELIM, every other byte is skipped (0).
+ * */
+static unsigned char const hexTable[256] = {
+  ['0'] = DIGIT | 0x0, ['1'] = DIGIT | 0x1, ['2'] = DIGIT | 0x2,
+  ['3'] = DIGIT | 0x3, ['4'] = DIGIT | 0x4, ['5'] = DIGIT | 0x5,
+  ['6'] = DIGIT | 0x6, ['7'] = DIGIT | 0x7, ['8'] = DIGIT | 0x8,
+  ['9'] = DIGIT | 0x9,
+  ['A'] = DIGIT | 0xA, ['B'] = DIGIT | 0xB, ['C'] = DIGIT | 0xC,
+  ['D'] = DIGIT | 0xD, ['E'] = DIGIT | 0xE, ['F'] = DIGIT | 0xF,
+  ['a'] = DIGIT | 0xA, ['b'] = DIGIT | 0xB, ['c'] = DIGIT | 0xC,
+  ['d'] = DIGIT | 0xD, ['e'] = DIGIT | 0xE, ['f'] = DIGIT | 0xF,
+  [' '] = DELIM, [','] = DELIM, ['}'] = DELIM, ['\n'] = DELIM, ['\t'] = DELIM,
+};
+
+#define TAB(c) hexTable[(unsigned char)(c)]
+
+
+/* Copies the next line into 'line' the same way
+ * fgets(line, MAX_LINE, stream) does.
+ * */
+static char const *next_line(char const *p, char const *const end,
+                             char line[static MAX_LINE])
+{
+  size_t n = 0;
+
+  while (p < end && n < MAX_LINE - 1) {
+    char const c = *p++;
+    line[n++] = c;
+    if (c == '\n') {
+      break;
+    }
+  }
+
+  line[n] = '\0';
+  return p;
+}
+
+
+/* Equivalent to NextInt() of libX11: returns the next number or -1 at the
+ * end of the data. The usual '0xHH' and '0xHHHH' tokens are decoded
+ * in one step, everything else goes through the generic loop.
+ * */
+static int next_int(char const **pp, char const *const end)
+{
+  char const *p = *pp;
+
+  while (p < end && TAB(*p) == DELIM) {
+    ++p;
+  }
+
+  if (end - p >= 7 && p[0] == '0' && p[1] == 'x') {
+    unsigned int const t2 = TAB(p[2]),
+                       t3 = TAB(p[3]),
+                       t4 = TAB(p[4]);
+
+    if ((t2 & t3 & DIGIT) && t4 == DELIM) {
+      *pp = p + 5;
+      return (int)(((t2 & 0xF) << 4) | (t3 & 0xF));
+    }
+
+    unsigned int const t5 = TAB(p[5]);
+
+    if ((t2 & t3 & t4 & t5 & DIGIT) && TAB(p[6]) == DELIM) {
+      *pp = p + 7;
+      return (int)(((t2 & 0xF) << 12) | ((t3 & 0xF) << 8) |
+                   ((t4 & 0xF) << 4) | (t5 & 0xF));
+    }
+  }
+
+  unsigned int value = 0;
+  int gotone = 0;
+
+  for (; p < end; ++p) {
+    unsigned int const t = TAB(*p);
+
+    if (t & DIGIT) {
+      value = (value << 4) + (t & 0xF);
+      gotone = 1;
+    } else if (t == DELIM && gotone) {
+      *pp = p + 1;
+      return (int)value;
+    }
+  }
+
+  *pp = p;
+  return -1;
+}
+
+
+int XbmBufferReserve(XbmBuffer *buffer, size_t size)
+{
+  if (buffer->capacity >= size) {
+    return 1;
+  }
+
+  unsigned char *const data = realloc(buffer->data, size);
+
+  if (!data) {
+    return 0;
+  }
+
+  buffer->data = data;
+  buffer->capacity = size;
+  return 1;
+}
+
+
+/* Reads the #defines up to the "bits[] = {" line, '*pp' is left on the
+ * first value.
+ * */
+static int parse_header(char const **pp, char const *const end,
+                        unsigned int *width, unsigned int *height,
+                        int *hotX, int *hotY, int *version10)
+{
+  char const *p = *pp;
+  char line[MAX_LINE];
+  char nameAndType[MAX_LINE];
+  unsigned int ww = 0,
+               hh = 0;
+  int hx = -1,
+      hy = -1,
+      value = 0;
+
+  while (p < end) {
+    p = next_line(p, end, line);
+
+    if (strlen(line) == MAX_LINE - 1) {
+      return BitmapFileInvalid;
+    }
+
+    char *type = NULL;
+
+    if (sscanf(line, "#define %s %d", nameAndType, &value) == 2) {
+      if (!(type = strrchr(nameAndType, '_'))) {
+        type = nameAndType;
+      } else {
+        type++;
+      }
+
+      if (!strcmp("width", type)) {
+        if (value <= 0) {
+          return BitmapFileInvalid;
+        }
+        ww = (unsigned int)value;
+      }
+
+      if (!strcmp("height", type)) {
+        if (value <= 0) {
+          return BitmapFileInvalid;
+        }
+        hh = (unsigned int)value;
+      }
+
+      if (!strcmp("hot", type)) {
+        if (type-- == nameAndType || type-- == nameAndType) {
+          continue;
+        }
+        if (!strcmp("x_hot", type)) {
+          hx = value;
+        }
+        if (!strcmp("y_hot", type)) {
+          hy = value;
+        }
+      }
+      continue;
+    }
+
+    int version10p = 0;
+
+    if (sscanf(line, "static short %s = {", nameAndType) == 1) {
+      version10p = 1;
+    } else if (sscanf(line, "static unsigned char %s = {", nameAndType) == 1) {
+      version10p = 0;
+    } else if (sscanf(line, "static char %s = {", nameAndType) == 1) {
+      version10p = 0;
+    } else {
+      continue;
+    }
+
+    if (!(type = strrchr(nameAndType, '_'))) {
+      type = nameAndType;
+    } else {
+      type++;
+    }
+
+    if (strcmp("bits[]", type)) {
+      continue;
+    }
+
+    if (!ww || !hh) {
+      return BitmapFileInvalid;
+    }
+
+    *pp = p;
+    *width = ww;
+    *height = hh;
+    *hotX = hx;
+    *hotY = hy;
+    *version10 = version10p;
+    return BitmapSuccess;
+  }
+
+  return BitmapFileInvalid;
+}
+
+
+/* Decodes 'rows' rows of 'ww' pixels into 'out'. X10 files are made of
+ * 16 bit values, a row of 1 to 8 pixels past a multiple of 16 has a
+ * padding byte that is dropped.
+ * */
+static int decode_rows(char const **pp, char const *const end,
+                       unsigned char *out, unsigned int ww, size_t rows,
+                       int version10p)
+{
+  size_t const stride = (ww + 7) / 8;
+  int value;
+
+  if (!version10p) {
+    size_t const size = stride * rows;
+
+    for (size_t bytes = 0; bytes < size; ++bytes) {
+      if ((value = next_int(pp, end)) < 0) {
+        return 0;
+      }
+      *out++ = value;
+    }
+    return 1;
+  }
+
+  int const padding = ((ww % 16) && ((ww % 16) < 9));
+  size_t const bytesPerLine = stride + padding;
+
+  for (size_t y = 0; y < rows; ++y) {
+    for (size_t bytes = 0; bytes < bytesPerLine; bytes += 2) {
+      if ((value = next_int(pp, end)) < 0) {
+        return 0;
+      }
+      *out++ = value;
+      if (bytes + 2 < bytesPerLine || !padding) {
+        *out++ = value >> 8;
+      }
+    }
+  }
+  return 1;
+}
+
+
+int XbmParse(char const *source, size_t len, XbmBuffer *buffer,
+             unsigned int *width, unsigned int *height,
+             int *hotX, int *hotY)
+{
+  char const *p = source;
+  char const *const end = source + len;
+  unsigned int ww = 0,
+               hh = 0;
+  int hx = -1,
+      hy = -1,
+      version10p = 0;
+  int const ret = parse_header(&p, end, &ww, &hh, &hx, &hy, &version10p);
+
+  if (ret != BitmapSuccess) {
+    return ret;
+  }
+
+  int const padding = ((ww % 16) && ((ww % 16) < 9) && version10p);
+  size_t const bytesPerLine = (ww + 7) / 8 + padding;
+
+  if (hh > (size_t)-1 / bytesPerLine) {
+    return BitmapFileInvalid;
+  }
+
+  if (!XbmBufferReserve(buffer, bytesPerLine * hh)) {
+    return BitmapNoMemory;
+  }
+
+  if (!decode_rows(&p, end, buffer->data, ww, hh, version10p)) {
+    return BitmapFileInvalid;
+  }
+
+  *width = ww;
+  *height = hh;
+
+  if (hotX) {
+    *hotX = hx;
+  }
+
+  if (hotY) {
+    *hotY = hy;
+  }
+
+  return BitmapSuccess;
+}
+
+
+/* The whole text of 'filename': mapped, or read for files that can not
+ * be mapped (pipes, /dev/stdin...). Released with release_source.
+ * */
+static int open_source(char const *filename, char **source, size_t *len,
+                       int *mapped)
+{
+  int const fd = open(filename, O_RDONLY);
+
+  if (fd == -1) {
+    return BitmapOpenFailed;
+  }
+
+  struct stat st;
+
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return BitmapOpenFailed;
+  }
+
+  if (S_ISREG(st.st_mode)) {
+    *len = (size_t)st.st_size;
+
+    if (*len == 0) {
+      close(fd);
+      return BitmapFileInvalid;
+    }
+
+    void *const map = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (map == MAP_FAILED) {
+      return BitmapOpenFailed;
+    }
+
+    posix_madvise(map, *len, POSIX_MADV_SEQUENTIAL);
+    *source = map;
+    *mapped = 1;
+    return BitmapSuccess;
+  }
+
+  size_t capacity = 0;
+
+  *len = 0;
+  *source = NULL;
+  *mapped = 0;
+
+  for (;;) {
+    if (*len == capacity) {
+      capacity = capacity ? capacity * 2 : BUFSIZ;
+
+      char *const tmp = realloc(*source, capacity);
+
+      if (!tmp) {
+        free(*source);
+        close(fd);
+        return BitmapNoMemory;
+      }
+      *source = tmp;
+    }
+
+    ssize_t const r = read(fd, *source + *len, capacity - *len);
+
+    if (r == -1 && errno == EINTR) {
+      continue;
+    }
+
+    if (r <= 0) {
+      break;
+    }
+
+    *len += (size_t)r;
+  }
+
+  close(fd);
+  return BitmapSuccess;
+}
+
+
+static void release_source(char *source, size_t len, int mapped)
+{
+  if (mapped) {
+    munmap(source, len);
+  } else {
+    free(source);
+  }
+}
+
+
+int XbmMapFile(char const *filename, XbmBuffer *buffer,
+               unsigned int *width, unsigned int *height,
+               int *hotX, int *hotY)
+{
+  char *source = NULL;
+  size_t len = 0;
+  int mapped = 0;
+  int ret = open_source(filename, &source, &len, &mapped);
+
+  if (ret != BitmapSuccess) {
+    return ret;
+  }
+
+  ret = XbmParse(source, len, buffer, width, height, hotX, hotY);
+  release_source(source, len, mapped);
+  return ret;
+}
+
+
+int XbmStreamFile(char const *filename, XbmBuffer *buffer, size_t stripSize,
+                  XbmStripProc strip, void *closure,
+                  unsigned int *width, unsigned int *height,
+                  int *hotX, int *hotY)
+{
+  char *source = NULL;
+  size_t len = 0;
+  int mapped = 0;
+  int ret = open_source(filename, &source, &len, &mapped);
+
+  if (ret != BitmapSuccess) {
+    return ret;
+  }
+
+  char const *p = source;
+  unsigned int ww = 0,
+               hh = 0;
+  int hx = -1,
+      hy = -1,
+      version10p = 0;
+
+  ret = parse_header(&p, source + len, &ww, &hh, &hx, &hy, &version10p);
+
+  size_t const stride = (ww + 7) / 8;
+  size_t const rows = stride && stripSize > stride ? stripSize / stride : 1;
+
+  if (ret == BitmapSuccess && !XbmBufferReserve(buffer, rows * stride)) {
+    ret = BitmapNoMemory;
+  }
+
+  for (unsigned int y = 0; ret == BitmapSuccess && y < hh; y += rows) {
+    unsigned int const n = (unsigned int)(hh - y < rows ? hh - y : rows);
+
+    if (!decode_rows(&p, source + len, buffer->data, ww, n, version10p)) {
+      ret = BitmapFileInvalid;
+    } else if (!strip(closure, buffer->data, ww, hh, y, n)) {
+      break;
+    }
+  }
+
+  release_source(source, len, mapped);
+
+  if (ret != BitmapSuccess) {
+    return ret;
+  }
+
+  *width = ww;
+  *height = hh;
+
+  if (hotX) {
+    *hotX = hx;
+  }
+
+  if (hotY) {
+    *hotY = hy;
+  }
+
+  return BitmapSuccess;
+}
+
+
+int XbmReadFile(char const *filename,
+                unsigned int *width, unsigned int *height,
+                unsigned char **data,
+                int *hotX, int *hotY)
+{
+  XbmBuffer buffer = {0};
+
+  int const ret = XbmMapFile(filename, &buffer, width, height, hotX, hotY);
+
+  if (ret != BitmapSuccess) {
+    XbmBufferFree(&buffer);
+    return ret;
+  }
+
+  *data = buffer.data;
+  return ret;
+}
+
+
+void XbmBufferFree(XbmBuffer *buffer)
+{
+  free(buffer->data);
+  buffer->data = NULL;
+  buffer->capacity = 0;
+}
+
+
+void XbmHashBegin(XbmHashState *state, unsigned int width, unsigned int height)
+{
+  state->h = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)width << 32 | height);
+  state->len = 0;
+}
+
+
+void XbmHashUpdate(XbmHashState *state, unsigned char const *data, size_t len)
+{
+  uint64_t h = state->h;
+  uint64_t v;
+  size_t const used = state->len & 7;
+  size_t i = 0;
+
+  state->len += len;
+
+  /* Completes the word left by the previous call. */
+  if (used) {
+    size_t const n = 8 - used < len ? 8 - used : len;
+
+    memcpy(state->tail + used, data, n);
+    i = n;
+
+    if (used + n < 8) {
+      return;
+    }
+
+    memcpy(&v, state->tail, 8);
+    h = (h ^ v) * 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 32;
+  }
+
+  /* 8 bytes per multiply. */
+  for (; i + 8 <= len; i += 8) {
+    memcpy(&v, data + i, 8);
+    h = (h ^ v) * 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 32;
+  }
+
+  memcpy(state->tail, data + i, len - i);
+  state->h = h;
+}
+
+
+uint64_t XbmHashEnd(XbmHashState *state)
+{
+  /* The tail is zero padded. */
+  uint64_t v = 0;
+
+  memcpy(&v, state->tail, state->len & 7);
+
+  uint64_t const h = (state->h ^ v ^ state->len) * 0xC4CEB9FE1A85EC53ULL;
+
+  return h ^ (h >> 29);
+}
+
+
+uint64_t XbmHash(unsigned char const *data,
+                 unsigned int width, unsigned int height)
+{
+  XbmHashState state;
+
+  XbmHashBegin(&state, width, height);
+  XbmHashUpdate(&state, data, (size_t)(width + 7) / 8 * height);
+  return XbmHashEnd(&state);
+}
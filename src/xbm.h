@@ -0,0 +1,92 @@
+/*
+  XBmpWall (xbmpwall)
+
+  Copyright (C) 2019-2022 by Daniel T. Borelli <danieltborelli@gmail.com>
+
+  This file is part of xbmpwall.
+
+  xbmpwall is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  xbmpwall is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with xbmpwall. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Output of the reader, it is reused between files and only grows. */
+typedef struct {
+  unsigned char *data;
+  size_t capacity;
+} XbmBuffer;
+
+/* Parses the file straight from its memory mapping into 'buffer'.
+ * The bits stay valid until the next read into the same buffer.
+ * Returns the values of XReadBitmapFileData.
+ * */
+int XbmMapFile(char const *filename, XbmBuffer *buffer,
+               unsigned int *width, unsigned int *height,
+               int *hotX, int *hotY);
+
+/* Called by XbmStreamFile with rows 'y' to 'y + rows - 1' of the
+ * 'width' x 'height' bitmap. Returns 0 to skip the rest of the file.
+ * */
+typedef int (*XbmStripProc)(void *closure, unsigned char const *bits,
+                            unsigned int width, unsigned int height,
+                            unsigned int y, unsigned int rows);
+
+/* Same as XbmMapFile, but the bits are decoded into 'buffer' in strips
+ * of about 'stripSize' bytes (at least one row) and handed to 'strip'.
+ * The memory used does not depend on the size of the bitmap.
+ * */
+int XbmStreamFile(char const *filename, XbmBuffer *buffer, size_t stripSize,
+                  XbmStripProc strip, void *closure,
+                  unsigned int *width, unsigned int *height,
+                  int *hotX, int *hotY);
+
+/* Reads an X10 or X11 bitmap file.
+ * Same contract and results as XReadBitmapFileData, but 'data'
+ * must be released with free() instead of XFree().
+ * */
+int XbmReadFile(char const *filename,
+                unsigned int *width, unsigned int *height,
+                unsigned char **data,
+                int *hotX, int *hotY);
+
+/* Same as XbmMapFile, from 'len' bytes already in memory. */
+int XbmParse(char const *source, size_t len, XbmBuffer *buffer,
+             unsigned int *width, unsigned int *height,
+             int *hotX, int *hotY);
+
+/* Grows 'buffer' to at least 'size' bytes, returns 0 without memory. */
+int XbmBufferReserve(XbmBuffer *buffer, size_t size);
+
+void XbmBufferFree(XbmBuffer *buffer);
+
+/* Content hash of decoded bits and their size, equal bitmaps give the
+ * same value whatever their file.
+ * */
+uint64_t XbmHash(unsigned char const *data,
+                 unsigned int width, unsigned int height);
+
+/* XbmHash in pieces, for bitmaps read in strips. */
+typedef struct {
+  uint64_t h;
+  size_t len;
+  unsigned char tail[8];
+} XbmHashState;
+
+void XbmHashBegin(XbmHashState *state, unsigned int width, unsigned int height);
+
+void XbmHashUpdate(XbmHashState *state, unsigned char const *data, size_t len);
+
+uint64_t XbmHashEnd(XbmHashState *state);
@@ -33,8 +33,33 @@ char const *const appResources[] = {
 };
 
 
+/* Application resources. */
+typedef struct {
+  int rootCacheSize; /* MiB */
+  Boolean stats,
+          dedup;
+} AppData;
+
+static AppData appData;
+
+static XtResource const appDataResources[] = {
+  {"rootCacheSize", "RootCacheSize", XtRInt, sizeof(int),
+    XtOffsetOf(AppData, rootCacheSize), XtRImmediate, (XtPointer)64},
+  {"stats", "Stats", XtRBoolean, sizeof(Boolean),
+    XtOffsetOf(AppData, stats), XtRImmediate, (XtPointer)False},
+  {"dedup", "Dedup", XtRBoolean, sizeof(Boolean),
+    XtOffsetOf(AppData, dedup), XtRImmediate, (XtPointer)False},
+};
+
+static XrmOptionDescRec const options[] = {
+  {"--stats", ".stats", XrmoptionNoArg, "True"},
+  {"--dedup", ".dedup", XrmoptionNoArg, "True"},
+};
+
+
 static Widget appWidget,
-              boxColors;
+              boxColors,
+              infoBitmaps;
 
 static Atom atomDeleteWindow;
 
@@ -42,16 +67,32 @@ static XtAppContext appContext;
 
 static Display *display = NULL;
 
-static char *bitmapName = NULL,
-            *colorFg = NULL,
-            *colorBg = NULL,
-            *bashcmd = NULL;
+static char *bitmapName = NULL;
+
+/* What Quit saves for --apply, filled in by Applied. */
+static struct state state = {0};
+
+/* Default colors, "#RRGGBB". */
+static char colorFg[8] = "#000000",
+            colorBg[8] = "#FFFFFF";
 
 static Boolean activeColorFg = True;
 
 static Cursor cursorUp = None,
               cursorDown = None;
 
+/* Bitmaps still streaming into the grid, see LoadBatch. */
+static size_t nloaded = 0;
+
+static int nbitmaps = 0;
+
+static XtInputId loaderInput = 0;
+
+static Boolean loadPending = False,
+               scanOver = False;
+
+static double loadStart = 0;
+
 
 #define Free(p) do {  \
   free(p);            \
@@ -138,9 +179,9 @@ static void ParseBashScript(void)
   char bg[10]; /* '#000000'\0 */
   char fg[10];
 
-  if (sscanf(buffer, "%*s -bitmap %s -bg %s -fg %s", bitmapName, bg, fg) == EOF) {
+  if (sscanf(buffer, "%*s -bitmap %s -bg %s -fg %s", bitmapName, bg, fg) != 3) {
       Free(bitmapName);
-      dbg_error("ParseBashScript: scanf() = EOF");
+      dbg_error("ParseBashScript: not a xsetroot script");
       return;
   }
 
@@ -154,6 +195,118 @@ static void ParseBashScript(void)
 }
 
 
+/* The state file, or the xsetroot script of older versions. */
+static void LoadState(void)
+{
+  struct state saved;
+
+  if (!StateLoad(&saved)) {
+    ParseBashScript();
+    return;
+  }
+
+  bitmapName = saved.bitmap;
+  PaletteFormat(saved.fg, colorFg);
+  PaletteFormat(saved.bg, colorBg);
+}
+
+
+/* xbmpwall --apply: the saved wallpaper, without Xt. */
+static void ApplyState(void)
+{
+  struct state saved;
+
+  if (!StateLoad(&saved)) {
+    fprintf(stderr, APP_NAME ": no wallpaper saved in ~" STATE_HIDE "\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* An archive entry, "<archive>:<name>". */
+  char *const entry = strstr(saved.bitmap, ARCHIVE_SUFFIX ":");
+
+  if (entry) {
+    char *const archive = strndup(saved.bitmap,
+        (size_t)(entry - saved.bitmap) + sizeof(ARCHIVE_SUFFIX) - 1);
+
+    assert(archive != NULL);
+
+    if (NULL == ArchiveOpen(archive, &(size_t){0})) {
+      exit(EXIT_FAILURE);
+    }
+    free(archive);
+  }
+
+  /* Only the part of the bitmap the screen shows is decoded. */
+  Display *const dpy = XOpenDisplay(NULL);
+
+  if (!dpy) {
+    fprintf(stderr, APP_NAME ": cannot open display\n");
+    exit(EXIT_FAILURE);
+  }
+
+  Screen *const screen = DefaultScreenOfDisplay(dpy);
+  XbmBuffer bits = {0};
+  unsigned int width, height;
+  int hotX, hotY;
+
+  if (ArchiveMapClip(saved.bitmap, &bits, (unsigned int)WidthOfScreen(screen),
+                     (unsigned int)HeightOfScreen(screen),
+                     &width, &height, &hotX, &hotY) != BitmapSuccess) {
+    fprintf(stderr, APP_NAME ": failed to read %s\n", saved.bitmap);
+    exit(EXIT_FAILURE);
+  }
+
+  /* Closes 'dpy' after RetainPermanent. */
+  if (!RootApplyPermanent(dpy, bits.data, width, height, saved.fg, saved.bg)) {
+    fprintf(stderr, APP_NAME ": failed to set the wallpaper %s\n", saved.bitmap);
+    exit(EXIT_FAILURE);
+  }
+
+  XbmBufferFree(&bits);
+  free(saved.bitmap);
+  exit(EXIT_SUCCESS);
+}
+
+
+/* The pixmaps of this connection die with it, the last wallpaper is
+ * set again through a connection that outlives the process.
+ * */
+static void PersistRoot(void)
+{
+  uint32_t fg, bg;
+  char const *const filename = ApplyShown(&fg, &bg);
+
+  if (NULL == filename) {
+    return;
+  }
+
+  XbmBuffer bits = {0};
+  unsigned int width, height;
+  int hotX, hotY;
+
+  Screen *const screen = DefaultScreenOfDisplay(display);
+
+  if (ArchiveMapClip(filename, &bits, (unsigned int)WidthOfScreen(screen),
+                     (unsigned int)HeightOfScreen(screen),
+                     &width, &height, &hotX, &hotY) != BitmapSuccess) {
+    fprintf(stderr, APP_NAME ": failed to read %s\n", filename);
+    XbmBufferFree(&bits);
+    return;
+  }
+
+  /* Not this connection, RetainPermanent would keep the window too. */
+  Display *const keep = XOpenDisplay(DisplayString(display));
+
+  if (!keep) {
+    fprintf(stderr, APP_NAME ": cannot open display\n");
+  } else if (!RootApplyPermanent(keep, bits.data, width, height, fg, bg)) {
+    fprintf(stderr, APP_NAME ": failed to keep the wallpaper on exit\n");
+  }
+
+  XbmBufferFree(&bits);
+}
+
+
 static void Quit(Widget w, XEvent *event, String *params , Cardinal *nparams)
 {
   (void)w;      /*UNUSED*/
@@ -165,11 +318,21 @@ static void Quit(Widget w, XEvent *event, String *params , Cardinal *nparams)
     return;
   }
 
-  if (NULL == bashcmd) {
-    dbg_notice("Quit: bashcmd == NULL");
+  PersistRoot();
+
+  if (NULL == state.bitmap) {
+    dbg_notice("Quit: nothing applied");
     exit(EXIT_SUCCESS);
   }
 
+  errno = 0;
+
+  if (!StateSave(&state)) {
+    fprintf(stderr, APP_NAME ": failed to write file:~" STATE_HIDE "\n");
+    perror(APP_NAME);
+    exit(EXIT_FAILURE);
+  }
+
   char filename[PATH_MAX];
 
   strncpy(filename, get_home_env(), PATH_MAX - 1);
@@ -180,7 +343,6 @@ static void Quit(Widget w, XEvent *event, String *params , Cardinal *nparams)
   FILE *const file = fopen(filename, "w+");
 
   if (!file) {
-    Free(bashcmd);
     fprintf(stderr, APP_NAME ": failed open file:%s\n", filename);
     perror(APP_NAME);
     exit(EXIT_FAILURE);
@@ -188,9 +350,7 @@ static void Quit(Widget w, XEvent *event, String *params , Cardinal *nparams)
 
   errno = 0;
 
-  if (fwrite(SCRIPT_HEAD, strlen(SCRIPT_HEAD), 1, file) == 0 ||
-      fwrite(bashcmd, strlen(bashcmd), 1, file) == 0) {
-    Free(bashcmd);
+  if (fwrite(SCRIPT_HEAD SCRIPT_APPLY, strlen(SCRIPT_HEAD SCRIPT_APPLY), 1, file) == 0) {
     fprintf(stderr, APP_NAME ": failed to write file:%s\n", filename);
     perror(APP_NAME);
     fclose(file);
@@ -198,65 +358,335 @@ static void Quit(Widget w, XEvent *event, String *params , Cardinal *nparams)
   }
 
   fclose(file);
-  fprintf(stdout, "%s\n", bashcmd);
-  Free(bashcmd);
+  fprintf(stdout, "%s", SCRIPT_APPLY);
   chmod(filename, S_IRWXU);
   exit(EXIT_SUCCESS);
 }
 
 
-static void set_bashcmd(char const fmt[static 1], ...)
+/* Called by the apply pipeline once the wallpaper is on screen. */
+static void Applied(char const *filename, uint32_t fg, uint32_t bg)
+{
+  free(state.bitmap);
+  state.bitmap = strdup(filename);
+  assert(state.bitmap != NULL);
+  state.fg = fg;
+  state.bg = bg;
+}
+
+
+/* The thumbnails show the colors of the wallpaper. */
+static void TintGrid(void)
 {
-  va_list ap;
-  int n = 0;
+  uint32_t fg = 0x000000,
+           bg = 0xFFFFFF;
 
-  va_start(ap, fmt);
-  n = vsnprintf(&(char){0}, (size_t){0}, fmt, ap);
-  va_end(ap);
+  PaletteParse(colorFg, &fg);
+  PaletteParse(colorBg, &bg);
+  GridTint(PaletteRGBToPixel(fg), PaletteRGBToPixel(bg));
+}
+
+
+/* Returns at once, see apply.c */
+static void XSetRoot(char const filename[static 1])
+{
+  uint32_t fg = 0x000000,
+           bg = 0xFFFFFF;
+
+  PaletteParse(colorFg, &fg);
+  PaletteParse(colorBg, &bg);
+  ApplyRequest(filename, fg, bg);
+}
 
-  assert(n > 0);
 
-  size_t const size = n + 1;
+static void ShowCount(void)
+{
+  char buffer[64];
+
+  snprintf(buffer, sizeof(buffer), INFO_BITMAPS, nbitmaps);
+  XtSetValues(infoBitmaps, &(Arg){XtNlabel, (XtArgVal)buffer}, 1);
+}
+
+
+static char const *base_name(char const *filename)
+{
+  char const *const slash = strrchr(filename, '/');
 
-  Free(bashcmd);
+  return slash ? slash + 1 : filename;
+}
 
-  bashcmd = calloc(size, sizeof(*bashcmd));
 
-  assert(bashcmd != NULL);
+/* The file under the pointer and its duplicates, in the info label. */
+static void Hover(char const *filename, char const *const aliases[],
+                  size_t naliases)
+{
+  if (NULL == filename) {
+    ShowCount();
+    return;
+  }
 
-  va_start(ap, fmt);
-  n = vsnprintf(bashcmd, size, fmt, ap);
-  va_end(ap);
+  char buffer[256];
+  int n = snprintf(buffer, sizeof(buffer), "%s", base_name(filename));
 
-  if (n < 0) {
-    Free(bashcmd);
-    dbg_assert("set_bashcmd: (n<0): vsnprintf() return %d", n);
+  for (size_t i = 0; i < naliases && n > 0 && (size_t)n < sizeof(buffer); ++i) {
+    n += snprintf(buffer + n, sizeof(buffer) - n, "%s%s",
+                  i ? ", " : "\nSame as: ", base_name(aliases[i]));
   }
+
+  XtSetValues(infoBitmaps, &(Arg){XtNlabel, (XtArgVal)buffer}, 1);
 }
 
 
-static void XSetRoot(char const filename[static 1])
+/* Adds to the grid the bitmaps already decoded, in order. */
+static Boolean LoadBatch(XtPointer clientData)
 {
-  int wpid    = 0,
-      pid     = 0,
-      ret     = 0;
+  (void)clientData; /*UNUSED*/
+
+  int const before = nbitmaps;
+  int ended = 0;
+  size_t const count = LoaderCount(&ended);
+  size_t n = 0;
+  struct bitmap *b;
+
+  while (nloaded < count && n < LOAD_BATCH &&
+         (b = LoaderPoll(nloaded)) != NULL) {
+
+    if (b->status == BitmapSuccess) {
+      /* Only the thumbnail is kept, the full bitmap is read on apply. */
+      GridAppend(b->filename, b->data, b->thumbWidth, b->thumbHeight,
+                 b->hash);
+      ++nbitmaps;
+    } else {
+      fprintf(stderr, "Error reading the bitmap file: %s\n", b->filename);
+    }
 
-  set_bashcmd(SCRIPT_XSETROOT, filename, colorBg, colorFg);
+    LoaderRelease(b);
+    ++nloaded;
+    ++n;
+  }
+
+  if (nbitmaps != before) {
+    ShowCount();
+  }
 
-  if ((pid = fork()) == 0) {
-    ret = execl(XSETROOT, "xsetroot", "-bitmap", filename,
-                "-bg", colorBg, "-fg", colorFg, NULL);
+  if (ended && !scanOver) {
+    StatsPhase("scan", loadStart);
+    scanOver = True;
+  }
 
-    if (ret == -1) {
-      fprintf(stderr, "There was a failure while "
-              "executing the process %s\n", XSETROOT);
+  if (ended && nloaded == count) {
+    StatsPhase("load", loadStart);
+    XtRemoveInput(loaderInput);
+    loaderInput = 0;
+    LoaderStop();
+    loadPending = False;
 
-      perror(APP_NAME);
+    if (0 == count) {
+      fprintf(stderr, "Missing parameters: file name .xbm\n");
+      exit(EXIT_FAILURE);
     }
-    exit(EXIT_SUCCESS);
+    return True;
   }
 
-  while ((wpid = wait(&(int){0})) > 0);
+  /* Keep going while there is work, else wait for the workers. */
+  loadPending = (n == LOAD_BATCH);
+  return !loadPending;
+}
+
+
+static void Decoded(XtPointer clientData, int *fd, XtInputId *id)
+{
+  (void)clientData; /*UNUSED*/
+  (void)id;         /*UNUSED*/
+
+  char drain[64];
+
+  while (read(*fd, drain, sizeof(drain)) > 0);
+
+  if (!loadPending && loaderInput != 0) {
+    loadPending = True;
+    XtAppAddWorkProc(appContext, LoadBatch, NULL);
+  }
+}
+
+
+/* xbmpwall --pack dir... -o collection.xbp */
+static void Pack(int argc, char *argv[])
+{
+  char const *output = NULL;
+  int count = 0;
+
+  for (int i = 0; i < argc; ++i) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else {
+      argv[count++] = argv[i];
+    }
+  }
+
+  if (NULL == output || 0 == count) {
+    fprintf(stderr, "Usage: xbmpwall --pack file.xbm|dir... -o collection" ARCHIVE_SUFFIX "\n");
+    exit(EXIT_FAILURE);
+  }
+
+  size_t nfiles = 0;
+  char **const files = ScanPaths(argv, count, &nfiles);
+
+  if (NULL == files || !ArchivePack(files, nfiles, output)) {
+    exit(EXIT_FAILURE);
+  }
+
+  exit(EXIT_SUCCESS);
+}
+
+
+static int has_archive_suffix(char const *filename)
+{
+  size_t const len = strlen(filename);
+  size_t const slen = sizeof(ARCHIVE_SUFFIX) - 1;
+
+  return len > slen && strcmp(filename + len - slen, ARCHIVE_SUFFIX) == 0;
+}
+
+
+/* Replaces the archives in 'filenames' by their entries. */
+static char **ExpandArchives(char **filenames, size_t *count)
+{
+  char **names = NULL;
+  size_t nnames = 0;
+
+  for (size_t i = 0; i < *count; ++i) {
+    size_t nentries = 1;
+    char **entries = &filenames[i];
+
+    if (has_archive_suffix(filenames[i])) {
+      entries = ArchiveOpen(filenames[i], &nentries);
+
+      if (NULL == entries) {
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    names = realloc(names, (nnames + nentries + 1) * sizeof(*names));
+    assert(names != NULL);
+    memcpy(&names[nnames], entries, nentries * sizeof(*names));
+    nnames += nentries;
+  }
+
+  *count = nnames;
+  return names;
+}
+
+
+/* From the threads of the scan, archives give their entries. */
+static void Found(char *const files[], size_t count)
+{
+  if (NULL == files) {
+    LoaderEnd();
+    return;
+  }
+
+  size_t first = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    if (!has_archive_suffix(files[i])) {
+      continue;
+    }
+
+    LoaderAdd((char const *const *)&files[first], i - first);
+    first = i + 1;
+
+    size_t nentries = 0;
+    char **const entries = ArchiveOpen(files[i], &nentries);
+
+    if (entries) {
+      LoaderAdd((char const *const *)entries, nentries);
+    }
+  }
+
+  LoaderAdd((char const *const *)&files[first], count - first);
+}
+
+
+/* Saved at each change, the session may end with the X server. */
+static void Rotated(char const *filename, uint32_t fg, uint32_t bg)
+{
+  Applied(filename, fg, bg);
+
+  if (!StateSave(&state)) {
+    perror(APP_NAME ": failed to write file:~" STATE_HIDE);
+  }
+}
+
+
+/* xbmpwall --rotate seconds [--shuffle] file.xbm|dir... */
+static void Rotate(int argc, char *argv[])
+{
+  char *end = NULL;
+  int shuffle = 0,
+      count = 0;
+  unsigned long const interval = argc > 0 ? strtoul(argv[0], &end, 10) : 0;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--shuffle") == 0) {
+      shuffle = 1;
+    } else {
+      argv[count++] = argv[i];
+    }
+  }
+
+  if (0 == interval || interval > UINT_MAX || *end != '\0' || 0 == count) {
+    fprintf(stderr, "Usage: xbmpwall --rotate seconds [--shuffle] file.xbm|dir...\n");
+    exit(EXIT_FAILURE);
+  }
+
+  size_t nfiles = 0;
+  char **files = ScanPaths(argv, count, &nfiles);
+
+  if (NULL == files) {
+    exit(EXIT_FAILURE);
+  }
+
+  files = ExpandArchives(files, &nfiles);
+
+  if (0 == nfiles) {
+    fprintf(stderr, APP_NAME ": no bitmaps to show\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* The colors chosen last in the GUI. */
+  LoadState();
+
+  uint32_t fg = 0x000000,
+           bg = 0xFFFFFF;
+
+  PaletteParse(colorFg, &fg);
+  PaletteParse(colorBg, &bg);
+
+  display = XOpenDisplay(NULL);
+
+  if (NULL == display) {
+    fprintf(stderr, APP_NAME ": cannot open display\n");
+    exit(EXIT_FAILURE);
+  }
+
+  ShmInit(display);
+  RotateRun(display, files, nfiles, (unsigned int)interval, shuffle, fg, bg,
+            Rotated);
+  exit(EXIT_SUCCESS);
+}
+
+
+/* Each edit of the filter field, 'clientData' is the text widget. */
+static void FilterChanged(Widget w, XtPointer clientData, XtPointer callData)
+{
+  (void)w;        /*UNUSED*/
+  (void)callData; /*UNUSED*/
+
+  String text = NULL;
+
+  XtVaGetValues((Widget)clientData, XtNstring, &text, NULL);
+  GridFilter(text);
 }
 
 
@@ -290,9 +720,7 @@ static void SetWallpaper(Widget w, XtPointer clientData, XtPointer callData)
 
   bitmapName = (char*)clientData;
   assert(bitmapName != NULL);
-  XtSetSensitive(appWidget, False);
   XSetRoot(bitmapName);
-  XtSetSensitive(appWidget, True);
 }
 
 
@@ -301,13 +729,10 @@ static void SetColor(Widget w, XtPointer clientData, XtPointer callData)
   (void)w;        /*UNUSED*/
   (void)callData; /*UNUSED*/
 
-  assert(clientData != NULL);
+  size_t const index = (size_t)clientData;
 
-  if (activeColorFg) {
-    colorFg = (char*)clientData;
-  } else {
-    colorBg = (char*)clientData;
-  }
+  PaletteFormat(PaletteRGB(index), activeColorFg ? colorFg : colorBg);
+  TintGrid();
 
   if (bitmapName) {
     XSetRoot(bitmapName);
@@ -329,30 +754,50 @@ int main(int argc, char *argv[argc + 1])
     }
   }
 
-  /* Default colors. */
-  colorFg = strdup("#000000"); /* 7 + 1 */
-  colorBg = strdup("#FFFFFF");
+  if (strcmp(argv[1], "--pack") == 0) {
+    Pack(argc - 2, &argv[2]);
+  }
 
-  ParseBashScript();
+  if (strcmp(argv[1], "--apply") == 0) {
+    ApplyState();
+  }
+
+  if (strcmp(argv[1], "--rotate") == 0) {
+    Rotate(argc - 2, &argv[2]);
+  }
+
+  double const startTime = StatsNow();
+  double phaseTime = startTime;
+
+  LoadState();
 
   XtSetLanguageProc(NULL, NULL, NULL);
 
   appWidget = XtVaAppInitialize(&appContext, (char*)APP_NAME,
-        NULL, 0,
+        (XrmOptionDescList)options, XtNumber(options),
         &argc, argv,
         (char**)appResources,
         NULL);
 
   display = XtDisplay(appWidget);
 
+  XtGetApplicationResources(appWidget, &appData,
+        (XtResourceList)appDataResources, XtNumber(appDataResources),
+        NULL, 0);
+
+  if (appData.stats) {
+    StatsInit(appContext, display);
+    StatsPhase("initialize", phaseTime);
+    phaseTime = StatsNow();
+  }
+
+  ShmInit(display);
+
   int const screenId     = DefaultScreen(display);
   Screen *const screen   = DefaultScreenOfDisplay(display);
-  int const depth        = DefaultDepth(display, 0);
-  Pixel const fg         = BlackPixelOfScreen(screen);
-  Pixel const bg         = WhitePixelOfScreen(screen);
-  Pixmap const icon      = XCreatePixmapFromBitmapData(display,
+  Pixmap const icon      = XCreateBitmapFromData(display,
                             RootWindowOfScreen(screen), (char *)icon_bits,
-                            icon_width, icon_height, fg, bg, depth);
+                            icon_width, icon_height);
 
   Dimension const x = (XDisplayWidth(display, screenId) - WIN_WIDTH) / 2;
   Dimension const y = (XDisplayHeight(display, screenId) - WIN_HEIGHT) / 2;
@@ -383,6 +828,7 @@ int main(int argc, char *argv[argc + 1])
       XtParseTranslationTable("<Message>WM_PROTOCOLS: quit()\n"));
 
   atomDeleteWindow = XInternAtom(display, "WM_DELETE_WINDOW", False);
+  StatsRoundTrip();
   XSetWMProtocols(display, XtWindow(appWidget), &atomDeleteWindow, 1);
 
   Widget const paned = XtVaCreateManagedWidget("paned", panedWidgetClass,
@@ -392,31 +838,52 @@ int main(int argc, char *argv[argc + 1])
       XtNmax, WIN_HEIGHT - 240,
       NULL);
 
-  Widget const viewport = XtVaCreateManagedWidget("viewport", viewportWidgetClass,
+  Widget const formBitmaps = XtVaCreateManagedWidget("form", formWidgetClass,
         paned,
         XtNwidth, WIN_WIDTH,
-        XtNheight, WIN_HEIGHT,
         XtNmax, (WIN_HEIGHT / 2) + 140,
         NULL);
 
-  Widget const boxBitmaps = XtVaCreateManagedWidget("box", boxWidgetClass,
-          viewport,
-          XtNwidth, WIN_WIDTH,
-          XtNheight, WIN_HEIGHT,
-          NULL);
-
-  Widget const infoBitmaps = XtVaCreateManagedWidget("info", labelWidgetClass,
-             boxBitmaps,
+  infoBitmaps = XtVaCreateManagedWidget("info", labelWidgetClass,
+             formBitmaps,
              XtNlabel, INFO_BITMAPS,
+             XtNtop, XawChainTop,
+             XtNbottom, XawChainTop,
+             XtNleft, XawChainLeft,
+             XtNright, XawChainLeft,
              NULL);
 
+  Widget const filter = XtVaCreateManagedWidget("filter", asciiTextWidgetClass,
+             formBitmaps,
+             XtNfromVert, infoBitmaps,
+             XtNwidth, GRID_WIDTH,
+             XtNeditType, XawtextEdit,
+             XtNstring, "",
+             XtNtop, XawChainTop,
+             XtNbottom, XawChainTop,
+             XtNleft, XawChainLeft,
+             XtNright, XawChainRight,
+             NULL);
+
+  XtOverrideTranslations(filter,
+      XtParseTranslationTable("<Key>Return: no-op()\n"));
+
+  XtAddCallback(XawTextGetSource(filter), XtNcallback, FilterChanged, filter);
+
+  /* Only the rows in view get a bitmap in the server. */
+  GridCreate(formBitmaps, filter, GRID_WIDTH, GRID_HEIGHT,
+             ITEM_SIZE, SetWallpaper);
+  GridCollapse(appData.dedup);
+  GridHover(Hover);
+
   Widget const viewportColors = XtVaCreateManagedWidget("viewport", viewportWidgetClass,
               paned,
               XtNwidth, WIN_WIDTH - 2 ,
               XtNheight, WIN_HEIGHT - 2,
               NULL);
 
-  boxColors = XtVaCreateManagedWidget("box", boxWidgetClass,
+  /* Managed once it is full, so the box is laid out a single time. */
+  boxColors = XtVaCreateWidget("box", boxWidgetClass,
         viewportColors,
         XtNwidth, WIN_WIDTH,
         XtNheight, WIN_HEIGHT,
@@ -430,76 +897,83 @@ int main(int argc, char *argv[argc + 1])
   char translationTable[] =  "<Key>space: conmuteStateColor()\n";
   XtOverrideTranslations(paned, XtParseTranslationTable(translationTable));
 
-  /* Load bitmaps */
-  int nbitmaps = 0;
+  StatsPhase("widgets", phaseTime);
+  phaseTime = StatsNow();
 
-  for(int i = 1; i < argc; ++i) {
+  loadStart = StatsNow();
 
-    char const *const filename = argv[i];
+  CacheInit(ITEM_SIZE);
 
-    unsigned int width, height;
-    unsigned char *data = NULL;
-    int hotX, hotY;
+  /* The directories are walked and decoded in background while the
+   * window is already up, the grid is filled from the event loop in
+   * order, see LoadBatch.
+   * */
+  LoaderStart(ITEM_SIZE);
 
-    if (XReadBitmapFileData(filename, &width, &height, &data, &hotX, &hotY)
-        != BitmapSuccess) {
-      fprintf(stderr, "Error reading the bitmap file: %s\n", filename);
-      exit(EXIT_FAILURE);
-    }
+  if (!ScanStart(&argv[1], argc - 1, Found)) {
+    exit(EXIT_FAILURE);
+  }
 
-    if (!data) {
-      continue;
-    }
+  loaderInput = XtAppAddInput(appContext, LoaderFd(),
+        (XtPointer)XtInputReadMask, Decoded, NULL);
 
-    Pixmap pixmap = XCreatePixmapFromBitmapData(display,
-            RootWindowOfScreen(screen),
-            (char *)data, width, height,
-            fg, bg, depth);
+  loadPending = True;
+  XtAppAddWorkProc(appContext, LoadBatch, NULL);
 
-    Widget widget = XtVaCreateManagedWidget(NULL,
-            commandWidgetClass,
-            boxBitmaps,
-            XtNbackgroundPixmap, pixmap,
-            XtNwidth, ITEM_SIZE,
-            XtNheight, ITEM_SIZE,
-            NULL);
+  ShowCount();
 
-    XtAddCallback(widget, XtNcallback, SetWallpaper, (char*)filename);
-    XFree(data);
-    nbitmaps = i;
-  }
+  char buffer[64];
+
+  phaseTime = StatsNow();
+
+  /* No round trips on TrueColor, see palette.c */
+  PaletteInit(display, screen);
+  TintGrid();
+
+  StatsPhase("palette", phaseTime);
+
+  ApplyInit(appContext, display,
+            (size_t)(appData.rootCacheSize > 0 ? appData.rootCacheSize : 0) << 20,
+            Applied);
 
-  size_t const ncolors = sizeof(hexColors) / sizeof(hexColors[0]);
-  char buffer[40];
+  phaseTime = StatsNow();
+
+  size_t const ncolors = PaletteSize();
 
   snprintf(buffer, sizeof(buffer), INFO_COLORS, ncolors);
   XtSetValues(infoColors, &(Arg){XtNlabel, (XtArgVal)buffer}, 1);
 
-  Colormap colormap = XDefaultColormap(display, screenId);
+  Widget swatches[SWATCH_CHUNK];
+  Cardinal nswatches = 0;
 
   for(size_t i = 0; i < ncolors; i++) {
-    XColor scrDef, exactDef;
-    XAllocNamedColor(display, colormap, hexColors[i], &scrDef, &exactDef);
-
-    Widget widget = XtVaCreateManagedWidget(NULL,
+    Widget widget = XtVaCreateWidget(NULL,
             commandWidgetClass,
             boxColors,
-            XtNbackground, scrDef.pixel,
+            XtNbackground, PalettePixel(i),
             XtNwidth, ITEM_SIZE / 2,
             XtNheight, ITEM_SIZE / 2,
             NULL);
 
-    XtAddCallback(widget, XtNcallback, SetColor, (XtPointer)hexColors[i]);
+    XtAddCallback(widget, XtNcallback, SetColor, (XtPointer)i);
+    swatches[nswatches++] = widget;
+
+    if (nswatches == SWATCH_CHUNK || i + 1 == ncolors) {
+      XtManageChildren(swatches, nswatches);
+      nswatches = 0;
+    }
   }
 
-  snprintf(buffer, sizeof(buffer), INFO_BITMAPS, nbitmaps);
-  XtSetValues(infoBitmaps, &(Arg){XtNlabel, (XtArgVal)buffer}, 1);
+  XtManageChild(boxColors);
 
   cursorUp  = XCreateFontCursor(display, XC_based_arrow_up);
   cursorDown  = XCreateFontCursor(display, XC_based_arrow_down);
 
   ChangeCursor();
 
+  StatsPhase("colors", phaseTime);
+  StatsPhase("startup", startTime);
+
   XtAppMainLoop(appContext);
   return EXIT_SUCCESS;
 }
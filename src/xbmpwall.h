@@ -26,8 +26,8 @@
 #error "config.h: SH not defined."
 #endif
 
-#ifndef XSETROOT
-#error "config.h: XSETROOT not defined."
+#ifndef BINDIR
+#error "BINDIR not defined, see Makefile.am"
 #endif
 
 #include <stdlib.h>
@@ -50,12 +50,27 @@
 #include <X11/Xaw/Command.h>
 #include <X11/Xaw/Label.h>
 #include <X11/Xaw/Box.h>
+#include <X11/Xaw/Form.h>
 #include <X11/Xaw/Paned.h>
 #include <X11/Xaw/Viewport.h>
 #include <X11/Xaw/Dialog.h>
+#include <X11/Xaw/AsciiText.h>
 
 #include "data/xbmpwall.xbm"
-#include "hexcolors.h"
+#include "palette.h"
+#include "loader.h"
+#include "xbm.h"
+#include "cache.h"
+#include "grid.h"
+#include "root.h"
+#include "apply.h"
+#include "scan.h"
+#include "stats.h"
+#include "archive.h"
+#include "state.h"
+#include "rotate.h"
+#include "shm.h"
+#include "layout.h"
 
 #define APP_NAME "XBmpWall"
 #define APP_TITLE APP_NAME " " VERSION
@@ -64,7 +79,8 @@
 #define SCRIPT_HIDE "/."SCRIPT
 #define SCRIPT_HEAD "#!" SH "\n"
 
-#define SCRIPT_XSETROOT XSETROOT " -bitmap %s -bg '%s' -fg '%s'"
+/* The wallpaper itself is in ~/.xbmpwall.state */
+#define SCRIPT_APPLY "exec " BINDIR "/xbmpwall --apply\n"
 
 #define INFO_BITMAPS APP_TITLE "\nOpen: %d"
 #define INFO_COLORS "Colors: %zu"
@@ -72,7 +88,11 @@
 #define WIN_WIDTH 640
 #define WIN_HEIGHT 600
 
-#define ITEM_SIZE 38
+/* Bitmaps added to the grid per pass of the event loop. */
+#define LOAD_BATCH 64
+
+#define GRID_WIDTH (WIN_WIDTH - 30)
+#define GRID_HEIGHT (WIN_HEIGHT / 2 + 66)
 
 #ifndef HAVE_LIMITS_H
 #ifndef PATH_MAX